@@ -0,0 +1,193 @@
+#ifndef ALLOCATORS_H
+#define ALLOCATORS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// Allocation strategies for data that lives for a frame, and a tracker for
+// whatever still goes through the global heap.
+//
+// frame_arena hands out memory from two bump arenas, one per frame in flight:
+// begin_frame() swaps them and resets the one being reused, so a frame's data
+// stays valid through the next frame and is freed without any bookkeeping.
+// Defining ALLOCATION_TRACKING_IMPLEMENTATION in one source file replaces
+// the global operator new and delete with counting versions; steady-state
+// frames should report zero.
+
+struct allocation_counters {
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t bytes;
+};
+
+// process-wide counters; only updated with ALLOCATION_TRACKING_IMPLEMENTATION
+inline std::atomic<uint64_t> heap_allocations { 0 };
+inline std::atomic<uint64_t> heap_frees { 0 };
+inline std::atomic<uint64_t> heap_bytes { 0 };
+
+inline allocation_counters heap_counters() {
+    return allocation_counters { heap_allocations.load(std::memory_order_relaxed),
+        heap_frees.load(std::memory_order_relaxed), heap_bytes.load(std::memory_order_relaxed) };
+}
+
+// differences of the counters across a frame
+class allocation_tracker {
+    private:
+        allocation_counters start = {};
+
+    public:
+        allocation_counters last_frame = {};
+        uint64_t frames = 0;
+        uint64_t dirty_frames = 0; // frames that touched the heap at all
+
+        void begin_frame() { start = heap_counters(); }
+
+        void end_frame() {
+            auto now = heap_counters();
+            last_frame = allocation_counters { now.allocations - start.allocations, now.frees - start.frees,
+                now.bytes - start.bytes };
+            frames++;
+            if (last_frame.allocations || last_frame.frees) dirty_frames++;
+        }
+};
+
+class linear_arena {
+    private:
+        unsigned char* memory = nullptr;
+        size_t capacity = 0;
+        size_t used = 0;
+        size_t peak = 0;
+        size_t overflow = 0; // bytes requested past capacity since the last reset
+
+    public:
+        explicit linear_arena(size_t bytes = 0) { reserve(bytes); }
+        ~linear_arena() { free(memory); }
+
+        linear_arena(const linear_arena&) = delete;
+        linear_arena& operator=(const linear_arena&) = delete;
+
+        // only between frames; invalidates everything handed out
+        void reserve(size_t bytes) {
+            if (bytes <= capacity) return;
+            free(memory);
+            memory = (unsigned char*)malloc(bytes);
+            capacity = bytes;
+            used = 0;
+        }
+
+        // null when the arena is full; callers fall back to the heap
+        void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+            auto offset = (used + alignment - 1) & ~(alignment - 1);
+            if (offset + size > capacity) {
+                overflow += size;
+                return nullptr;
+            }
+            used = offset + size;
+            peak = std::max(peak, used);
+            return memory + offset;
+        }
+
+        // Grows to fit the last frame's overflow, so a frame that spilled
+        // once doesn't spill again.
+        void reset() {
+            if (overflow) reserve(capacity + overflow + capacity / 2);
+            used = 0;
+            overflow = 0;
+        }
+
+        size_t size() const { return used; }
+        size_t high_water() const { return peak; }
+        bool owns(const void* p) const { return p >= memory && p < memory + capacity; }
+};
+
+class frame_arena {
+    private:
+        linear_arena arenas[2];
+        unsigned int current = 0;
+
+    public:
+        explicit frame_arena(size_t bytes_per_frame) : arenas { linear_arena(bytes_per_frame), linear_arena(bytes_per_frame) } {}
+
+        // frees what was allocated two frames ago
+        void begin_frame() {
+            current ^= 1;
+            arenas[current].reset();
+        }
+
+        void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+            return arenas[current].allocate(size, alignment);
+        }
+
+        template <typename T>
+        T* allocate_array(size_t count) {
+            return (T*)allocate(count * sizeof(T), alignof(T));
+        }
+
+        bool owns(const void* p) const { return arenas[0].owns(p) || arenas[1].owns(p); }
+        const linear_arena& this_frame() const { return arenas[current]; }
+};
+
+// Standard allocator over a frame_arena, for containers rebuilt every frame.
+// Memory is only reclaimed by begin_frame(); requests that don't fit fall
+// back to the heap and are the only ones actually freed. Containers using it
+// must be gone before the arena is reused, i.e. within the next frame.
+template <typename T>
+struct frame_allocator {
+    typedef T value_type;
+    frame_arena* arena;
+
+    explicit frame_allocator(frame_arena* arena) : arena(arena) {}
+    template <typename U>
+    frame_allocator(const frame_allocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) {
+        if (auto p = arena->allocate_array<T>(count)) return p;
+        return (T*)::operator new(count * sizeof(T));
+    }
+    void deallocate(T* p, size_t) {
+        if (!arena->owns(p)) ::operator delete(p);
+    }
+
+    template <typename U>
+    bool operator==(const frame_allocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const frame_allocator<U>& other) const { return arena != other.arena; }
+};
+
+template <typename T>
+using frame_vector = std::vector<T, frame_allocator<T>>;
+
+#endif
+
+// outside the include guard so the file that defines the macro gets it even
+// when allocators.h was already included
+#if defined(ALLOCATION_TRACKING_IMPLEMENTATION) && !defined(ALLOCATION_TRACKING_IMPLEMENTED)
+#define ALLOCATION_TRACKING_IMPLEMENTED
+void* operator new(size_t size) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    heap_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (auto p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+void operator delete(void* p) noexcept {
+    if (p) heap_frees.fetch_add(1, std::memory_order_relaxed);
+    free(p);
+}
+void operator delete[](void* p) noexcept {
+    operator delete(p);
+}
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+void operator delete[](void* p, size_t) noexcept {
+    operator delete(p);
+}
+#endif
@@ -0,0 +1,201 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "assrt.h"
+#include "lz4.h"
+#include "mapped_file.h"
+
+// Packed asset archive and the virtual file system reading from it.
+//
+// An archive is a header, the entry data, a table of contents sorted by
+// path hash and the path strings, written by pack_assets from data/. It is
+// mapped once; lookups are a binary search over the table, and stored
+// entries are handed out as views straight into the mapping. Entries the
+// packer found worth compressing are LZ4 blocks and get decoded on open.
+// asset_vfs falls back to loose files for anything the archive doesn't
+// have, or when there is no archive at all.
+
+const char archive_magic[8] = { 'L', 'O', 'G', 'L', 'P', 'A', 'K', '\0' };
+const uint32_t archive_version = 1;
+// entry data starts on this boundary so decoders can read it in place
+const uint64_t archive_alignment = 16;
+
+enum archive_compression : uint32_t {
+    archive_stored = 0,
+    archive_lz4 = 1,
+};
+
+struct archive_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_count;
+    uint64_t toc_offset;
+    uint64_t names_offset;
+    uint64_t names_size;
+};
+
+struct archive_entry {
+    uint64_t hash; // archive_hash of the path
+    uint64_t offset;
+    uint64_t size; // bytes in the archive
+    uint64_t original_size;
+    uint32_t compression;
+    uint32_t name_offset; // into the names block, to tell colliding hashes apart
+    uint32_t name_length;
+    uint32_t padding;
+};
+
+// FNV-1a of the path as given, '/' separated
+inline uint64_t archive_hash(const char* path, size_t length) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)path[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+class asset_archive {
+    private:
+        mapped_file file;
+        const archive_header* header = nullptr;
+        const archive_entry* toc = nullptr;
+        const char* names = nullptr;
+
+    public:
+        // false, with nothing mounted, unless the whole table checks out
+        bool open(const char* path) {
+            header = nullptr;
+            if (!file.open(path) || file.size() < sizeof(archive_header)) return false;
+            auto h = (const archive_header*)file.data();
+            auto size = file.size();
+            if (memcmp(h->magic, archive_magic, sizeof(archive_magic)) != 0 || h->version != archive_version
+                    || h->toc_offset > size || h->entry_count > (size - h->toc_offset) / sizeof(archive_entry)
+                    || h->names_offset > size || h->names_size > size - h->names_offset) {
+                assrt(false, "Invalid asset archive {%s}", path);
+                return false;
+            }
+            auto entries = (const archive_entry*)(file.data() + h->toc_offset);
+            for (uint32_t i = 0; i < h->entry_count; i++) {
+                const auto& e = entries[i];
+                if (e.offset > size || e.size > size - e.offset
+                        || (uint64_t)e.name_offset + e.name_length > h->names_size) {
+                    assrt(false, "Corrupt entry {%u} in asset archive {%s}", i, path);
+                    return false;
+                }
+            }
+            header = h;
+            toc = entries;
+            names = (const char*)file.data() + h->names_offset;
+            return true;
+        }
+
+        bool is_open() const { return header != nullptr; }
+        uint32_t size() const { return header ? header->entry_count : 0; }
+
+        const archive_entry* find(const char* path) const {
+            if (!header) return nullptr;
+            auto length = strlen(path);
+            auto hash = archive_hash(path, length);
+            auto end = toc + header->entry_count;
+            auto it = std::lower_bound(toc, end, hash, [](const archive_entry& e, uint64_t h) { return e.hash < h; });
+            for (; it != end && it->hash == hash; it++) {
+                if (it->name_length == length && memcmp(names + it->name_offset, path, length) == 0) return it;
+            }
+            return nullptr;
+        }
+
+        const unsigned char* data(const archive_entry& entry) const {
+            return file.data() + entry.offset;
+        }
+};
+
+// Bytes of one asset. Stored archive entries point into the archive mapping
+// and copy nothing; loose files own their mapping, compressed entries their
+// decoded buffer. Empty when the asset couldn't be found or decoded.
+class asset_view {
+    private:
+        const unsigned char* bytes = nullptr;
+        size_t length = 0;
+        mapped_file file;
+        std::vector<unsigned char> buffer;
+
+        friend class asset_vfs;
+
+    public:
+        asset_view() {}
+        asset_view(asset_view&& other) noexcept
+            : bytes(std::exchange(other.bytes, nullptr)), length(std::exchange(other.length, 0)),
+            file(std::move(other.file)), buffer(std::move(other.buffer)) {}
+        asset_view& operator=(asset_view&& other) noexcept {
+            bytes = std::exchange(other.bytes, nullptr);
+            length = std::exchange(other.length, 0);
+            file = std::move(other.file);
+            buffer = std::move(other.buffer);
+            return *this;
+        }
+
+        const unsigned char* data() const { return bytes; }
+        size_t size() const { return length; }
+        explicit operator bool() const { return bytes != nullptr; }
+};
+
+class asset_vfs {
+    private:
+        asset_archive archive;
+
+    public:
+        // loose files keep working when the archive is missing
+        bool mount(const char* archive_path) {
+            return archive.open(archive_path);
+        }
+
+        const asset_archive& get_archive() const { return archive; }
+
+        asset_view open(const char* path) const {
+            asset_view view;
+            if (auto entry = archive.find(path)) {
+                if (entry->compression == archive_stored) {
+                    view.bytes = archive.data(*entry);
+                    view.length = entry->size;
+                } else if (entry->compression == archive_lz4) {
+                    view.buffer.resize(entry->original_size);
+                    if (lz4_decompress(archive.data(*entry), entry->size, view.buffer.data(), view.buffer.size())) {
+                        view.bytes = view.buffer.data();
+                        view.length = view.buffer.size();
+                    }
+                }
+                assrt(view.bytes, "Failed to read {%s} from the asset archive", path);
+                return view;
+            }
+            if (view.file.open(path)) {
+                view.bytes = view.file.data();
+                view.length = view.file.size();
+            }
+            return view;
+        }
+
+        // whole asset as a string; loose_only skips the archive, e.g. to
+        // pick up edits to the source files
+        std::string read_text(const char* path, bool loose_only = false) const {
+            if (!loose_only) {
+                auto view = open(path);
+                return view ? std::string((const char*)view.data(), view.size()) : std::string();
+            }
+            std::ifstream file(path, std::ios::binary);
+            std::stringstream stream;
+            stream << file.rdbuf();
+            return stream.str();
+        }
+};
+
+#endif
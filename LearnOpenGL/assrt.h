@@ -1,17 +1,14 @@
 #ifndef ASSRT_H
 #define ASSRT_H
 
-#include <stdio.h>
-#include <cstdarg>
+#include "logger.h"
 
-inline void assrt(bool pass_condition, const char* fail_message, ...) {
+// logs fail_message, printf-style, as an error; errors are flushed before
+// this returns, so the message is out even if a crash follows
+template <typename... Args>
+inline void assrt(bool pass_condition, const char* fail_message, const Args&... args) {
     if (pass_condition) return;
-    va_list args;
-    va_start(args, fail_message);
-    fprintf(stderr, "[LearnOpenGL] ERROR: ");
-    vfprintf(stderr, fail_message, args);
-    printf("\n");
-    va_end(args);
+    logger.log(log_level::error, nullptr, fail_message, args...);
 }
 
 #endif
@@ -0,0 +1,202 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Pieces of the renderer benchmark (LearnOpenGL_bench, see main.cpp):
+// frame statistics, a GPU frame timer, and a JSON report that a later run
+// can be compared against.
+//
+// Reports are flat on purpose: one object per result, numbers and strings
+// only. read_bench_report() only understands what write_bench_report()
+// writes; it is not a JSON parser.
+
+struct bench_result {
+    std::string path; // draw path, e.g. culling mode
+    unsigned int objects = 0;
+    unsigned int frames = 0;
+    double cpu_ms_mean = 0.0;
+    double cpu_ms_p50 = 0.0;
+    double cpu_ms_p95 = 0.0;
+    double cpu_ms_p99 = 0.0;
+    double gpu_ms_mean = 0.0; // 0 when no timer result came back
+    // per frame, averaged over the run
+    double draw_calls = 0.0;
+    double state_changes = 0.0;
+    double triangles = 0.0;
+};
+
+// nearest-rank percentile, p in [0, 100]
+inline double percentile(std::vector<double> samples, double p) {
+    if (samples.empty()) return 0.0;
+    std::sort(samples.begin(), samples.end());
+    auto rank = (size_t)(p / 100.0 * (samples.size() - 1) + 0.5);
+    return samples[std::min(rank, samples.size() - 1)];
+}
+
+inline double mean(const std::vector<double>& samples) {
+    if (samples.empty()) return 0.0;
+    double sum = 0.0;
+    for (auto s : samples) sum += s;
+    return sum / samples.size();
+}
+
+// GL_TIME_ELAPSED around each frame; results are read a few frames later
+// so waiting for them doesn't stall the pipeline
+class gpu_frame_timer {
+    private:
+        static const unsigned int latency = 4;
+        GLuint queries[latency] = {};
+        unsigned int issued = 0;
+        unsigned int read = 0;
+
+        void collect(bool wait) {
+            while (read < issued) {
+                auto query = queries[read % latency];
+                GLint available = 0;
+                if (!wait) glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+                if (!wait && !available) return;
+                GLuint64 nanoseconds = 0;
+                glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+                milliseconds.push_back(nanoseconds / 1e6);
+                read++;
+            }
+        }
+
+    public:
+        std::vector<double> milliseconds;
+
+        void begin_frame() {
+            if (!queries[0]) glGenQueries(latency, queries);
+            // a slot is only reused once its result is in
+            if (issued - read == latency) collect(true);
+            glBeginQuery(GL_TIME_ELAPSED, queries[issued % latency]);
+        }
+
+        void end_frame() {
+            glEndQuery(GL_TIME_ELAPSED);
+            issued++;
+            collect(false);
+        }
+
+        // waits for the frames still in flight
+        void finish() { collect(true); }
+
+        void reset() {
+            finish();
+            milliseconds.clear();
+        }
+
+        void release() {
+            if (queries[0]) glDeleteQueries(latency, queries);
+            queries[0] = 0;
+            issued = read = 0;
+        }
+};
+
+inline bool write_bench_report(const char* path, const std::vector<bench_result>& results) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        printf("[bench] Error: can't write {%s}\n", path);
+        return false;
+    }
+    fprintf(file, "{\n  \"version\": 1,\n  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        auto& r = results[i];
+        fprintf(file, "    {\"path\": \"%s\", \"objects\": %u, \"frames\": %u, \"cpu_ms_mean\": %.4f, "
+                "\"cpu_ms_p50\": %.4f, \"cpu_ms_p95\": %.4f, \"cpu_ms_p99\": %.4f, \"gpu_ms_mean\": %.4f, "
+                "\"draw_calls\": %.1f, \"state_changes\": %.1f, \"triangles\": %.1f}%s\n",
+                r.path.c_str(), r.objects, r.frames, r.cpu_ms_mean, r.cpu_ms_p50, r.cpu_ms_p95, r.cpu_ms_p99,
+                r.gpu_ms_mean, r.draw_calls, r.state_changes, r.triangles, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return true;
+}
+
+// value after "key": on a report line, 0 when missing
+inline double bench_field(const std::string& line, const char* key) {
+    auto at = line.find("\"" + std::string(key) + "\":");
+    if (at == std::string::npos) return 0.0;
+    return strtod(line.c_str() + at + strlen(key) + 3, nullptr);
+}
+
+inline std::string bench_string_field(const std::string& line, const char* key) {
+    auto at = line.find("\"" + std::string(key) + "\": \"");
+    if (at == std::string::npos) return std::string();
+    auto begin = at + strlen(key) + 5;
+    auto end = line.find('"', begin);
+    return end == std::string::npos ? std::string() : line.substr(begin, end - begin);
+}
+
+inline std::vector<bench_result> read_bench_report(const char* path) {
+    std::vector<bench_result> results;
+    std::ifstream file(path);
+    if (!file) printf("[bench] Error: can't read {%s}\n", path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.find("\"path\":") == std::string::npos) continue;
+        bench_result r;
+        r.path = bench_string_field(line, "path");
+        r.objects = (unsigned int)bench_field(line, "objects");
+        r.frames = (unsigned int)bench_field(line, "frames");
+        r.cpu_ms_mean = bench_field(line, "cpu_ms_mean");
+        r.cpu_ms_p50 = bench_field(line, "cpu_ms_p50");
+        r.cpu_ms_p95 = bench_field(line, "cpu_ms_p95");
+        r.cpu_ms_p99 = bench_field(line, "cpu_ms_p99");
+        r.gpu_ms_mean = bench_field(line, "gpu_ms_mean");
+        r.draw_calls = bench_field(line, "draw_calls");
+        r.state_changes = bench_field(line, "state_changes");
+        r.triangles = bench_field(line, "triangles");
+        results.push_back(r);
+    }
+    return results;
+}
+
+// prints every result against its baseline; returns how many got slower by
+// more than threshold (0.1 is 10%). Counts that changed are listed but
+// aren't regressions: a culling change is supposed to move them.
+inline unsigned int compare_bench_reports(const std::vector<bench_result>& baseline,
+        const std::vector<bench_result>& current, double threshold) {
+    unsigned int regressions = 0;
+    for (const auto& now : current) {
+        auto before = std::find_if(baseline.begin(), baseline.end(), [&now](const bench_result& r) {
+            return r.path == now.path && r.objects == now.objects;
+        });
+        if (before == baseline.end()) {
+            printf("  %-14s %8u objects: not in the baseline\n", now.path.c_str(), now.objects);
+            continue;
+        }
+        struct metric { const char* name; double before, now; };
+        const metric metrics[] = {
+            { "cpu p50", before->cpu_ms_p50, now.cpu_ms_p50 },
+            { "cpu p95", before->cpu_ms_p95, now.cpu_ms_p95 },
+            { "cpu p99", before->cpu_ms_p99, now.cpu_ms_p99 },
+            { "gpu", before->gpu_ms_mean, now.gpu_ms_mean },
+        };
+        for (const auto& m : metrics) {
+            if (m.before <= 0.0) continue;
+            auto change = m.now / m.before - 1.0;
+            auto regressed = change > threshold;
+            regressions += regressed;
+            printf("  %-14s %8u objects %-8s %9.3f -> %9.3f ms %+6.1f%%%s\n", now.path.c_str(), now.objects,
+                    m.name, m.before, m.now, 100.0 * change, regressed ? "  REGRESSION" : "");
+        }
+        if (before->draw_calls != now.draw_calls || before->triangles != now.triangles) {
+            printf("  %-14s %8u objects draws %.1f -> %.1f, triangles %.1f -> %.1f\n", now.path.c_str(),
+                    now.objects, before->draw_calls, now.draw_calls, before->triangles, now.triangles);
+        }
+    }
+    return regressions;
+}
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef BINDLESS_H
+#define BINDLESS_H
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "texture_array.h"
+
+// Optional ARB_bindless_texture path on top of texture_arrays.
+//
+// Every array gets a resident handle, and every texture id gets an entry in
+// one uniform buffer holding its array handle, layer and uv rect. Shaders
+// index that table directly, so materials are two integers and the number
+// of arrays is no longer bounded by texture units.
+
+class bindless_textures {
+    public:
+        // 512 slots of 32 bytes fill the 16KB uniform block every implementation supports
+        static constexpr unsigned int max_textures = 512;
+
+        // matches the std140 layout of texture_slot in shader.frag
+        struct slot {
+            GLuint64 handle;
+            float layer;
+            float padding;
+            glm::vec4 uv_rect;
+        };
+
+    private:
+        GLuint ubo = 0;
+        std::vector<GLuint64> handles; // per array
+
+    public:
+        // needs the extension and a 4.0 context for GLSL 4.00
+        static bool supported() {
+            return GLAD_GL_ARB_bindless_texture && GLVersion.major >= 4;
+        }
+
+        // handles pair each array with its sampler object; neither can change afterwards
+        void build(const texture_arrays& textures, sampler_cache& samplers) {
+            auto texture_count = textures.size();
+            assrt(texture_count <= max_textures, "Too many bindless textures {%u}", texture_count);
+            release();
+            for (const auto& info : textures.get_arrays()) {
+                auto handle = glGetTextureSamplerHandleARB(info.texture, samplers.get(info.sampler));
+                glMakeTextureHandleResidentARB(handle);
+                handles.push_back(handle);
+            }
+
+            std::vector<slot> slots(texture_count);
+            for (unsigned int id = 0; id < texture_count; id++) {
+                const auto& layer = textures.get(id);
+                slots[id] = slot { handles[layer.array], (float)layer.layer, 0.f, layer.uv_rect };
+            }
+            glGenBuffers(1, &ubo);
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+            glBufferData(GL_UNIFORM_BUFFER, slots.size() * sizeof(slot), slots.data(), GL_STATIC_DRAW);
+        }
+
+        void bind(GLuint binding) const {
+            glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo);
+        }
+
+        // call while the context is still current
+        void release() {
+            for (auto handle : handles) glMakeTextureHandleNonResidentARB(handle);
+            handles.clear();
+            if (ubo) glDeleteBuffers(1, &ubo);
+            ubo = 0;
+        }
+};
+
+#endif
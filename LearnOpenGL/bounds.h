@@ -0,0 +1,133 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <algorithm>
+
+#include "glm/glm.hpp"
+
+struct aabb {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    glm::vec3 center() const { return 0.5f * (min + max); }
+    glm::vec3 extent() const { return 0.5f * (max - min); }
+    float surface_area() const {
+        auto d = glm::max(max - min, glm::vec3(0.f));
+        return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+};
+
+// starts empty so that any union replaces it
+inline aabb aabb_empty() {
+    return aabb { glm::vec3(1e30f), glm::vec3(-1e30f) };
+}
+
+inline bool aabb_overlap(const aabb& a, const aabb& b) {
+    return a.min.x <= b.max.x && a.max.x >= b.min.x
+        && a.min.y <= b.max.y && a.max.y >= b.min.y
+        && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+inline aabb aabb_union(const aabb& a, const aabb& b) {
+    return aabb { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+}
+
+inline aabb aabb_translate(const aabb& box, glm::vec3 offset) {
+    return aabb { box.min + offset, box.max + offset };
+}
+
+// bounds of a box after an affine transform (Arvo's method)
+inline aabb aabb_transform(const aabb& box, const glm::mat4& m) {
+    auto center = glm::vec3(m * glm::vec4(box.center(), 1.f));
+    auto extent = box.extent();
+    glm::vec3 radius;
+    for (int i = 0; i < 3; i++) {
+        radius[i] = glm::abs(m[0][i]) * extent.x
+                  + glm::abs(m[1][i]) * extent.y
+                  + glm::abs(m[2][i]) * extent.z;
+    }
+    return aabb { center - radius, center + radius };
+}
+
+struct ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+};
+
+// 1 / direction, clamped to stay finite: with an infinite reciprocal a ray
+// parallel to an axis and starting on a slab plane gets 0 * inf = NaN there,
+// which min and max then keep or drop depending on operand order
+inline glm::vec3 ray_inverse_direction(const ray& r) {
+    const float largest = 1e30f;
+    return glm::clamp(1.f / r.direction, -largest, largest);
+}
+
+// slab test; returns the entry distance, or a negative value on a miss
+inline float ray_aabb(const ray& r, const aabb& box, float max_t) {
+    float t0 = 0.f, t1 = max_t;
+    auto inverse = ray_inverse_direction(r);
+    for (int i = 0; i < 3; i++) {
+        auto inv = inverse[i];
+        auto t_near = (box.min[i] - r.origin[i]) * inv;
+        auto t_far = (box.max[i] - r.origin[i]) * inv;
+        if (t_near > t_far) std::swap(t_near, t_far);
+        t0 = t_near > t0 ? t_near : t0;
+        t1 = t_far < t1 ? t_far : t1;
+        if (t0 > t1) return -1.f;
+    }
+    return t0;
+}
+
+// planes point inwards: dot(plane.xyz, p) + plane.w >= 0 inside
+struct frustum {
+    glm::vec4 planes[6];
+};
+
+// Gribb & Hartmann plane extraction from a (projection * view) matrix
+inline frustum frustum_from_matrix(const glm::mat4& m) {
+    frustum f;
+    for (int i = 0; i < 3; i++) {
+        auto row = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+        auto w = glm::vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+        f.planes[i * 2] = w + row;
+        f.planes[i * 2 + 1] = w - row;
+    }
+    for (auto& plane : f.planes) {
+        plane = plane / glm::length(glm::vec3(plane));
+    }
+    return f;
+}
+
+// corners are where one plane of each opposite pair meets
+inline aabb frustum_bounds(const frustum& f) {
+    auto box = aabb_empty();
+    for (int corner = 0; corner < 8; corner++) {
+        auto a = f.planes[corner & 1], b = f.planes[2 + ((corner >> 1) & 1)], c = f.planes[4 + (corner >> 2)];
+        auto na = glm::vec3(a), nb = glm::vec3(b), nc = glm::vec3(c);
+        auto p = -(a.w * glm::cross(nb, nc) + b.w * glm::cross(nc, na) + c.w * glm::cross(na, nb))
+                / glm::dot(na, glm::cross(nb, nc));
+        box = aabb_union(box, aabb { p, p });
+    }
+    return box;
+}
+
+enum class cull_result { outside, intersects, inside };
+
+inline cull_result frustum_test(const frustum& f, const aabb& box) {
+    auto result = cull_result::inside;
+    for (auto& plane : f.planes) {
+        auto n = glm::vec3(plane);
+        // corners furthest along and against the plane normal
+        auto positive = glm::vec3(n.x > 0 ? box.max.x : box.min.x,
+                n.y > 0 ? box.max.y : box.min.y,
+                n.z > 0 ? box.max.z : box.min.z);
+        if (glm::dot(n, positive) + plane.w < 0) return cull_result::outside;
+        auto negative = glm::vec3(n.x > 0 ? box.min.x : box.max.x,
+                n.y > 0 ? box.min.y : box.max.y,
+                n.z > 0 ? box.min.z : box.max.z);
+        if (glm::dot(n, negative) + plane.w < 0) result = cull_result::intersects;
+    }
+    return result;
+}
+
+#endif
@@ -0,0 +1,451 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BVH_SSE 1
+#endif
+
+#include "glm/glm.hpp"
+#include "bounds.h"
+#include "thread_pool.h"
+
+// Four-wide bounding volume hierarchy over object bounds.
+//
+// Child bounds are stored as structure-of-arrays so one node is tested with a
+// single 4-lane pass (SSE when available). Built top down with binned SAH,
+// taking the two best splits of the largest child until a node has four
+// children. Moving objects only need refit(), which keeps the topology and
+// recomputes bounds bottom up.
+
+const uint32_t bvh_empty_slot = 0xffffffffu;
+
+struct alignas(16) bvh4_node {
+    float min_x[4], min_y[4], min_z[4];
+    float max_x[4], max_y[4], max_z[4];
+    // inner: index of the child node; leaf: first entry in bvh4::items
+    uint32_t child[4];
+    // leaf item count, 0 for inner children and empty slots
+    uint32_t count[4];
+
+    bool is_leaf(int slot) const { return count[slot] > 0; }
+    bool is_inner(int slot) const { return count[slot] == 0 && child[slot] != bvh_empty_slot; }
+
+    void set_bounds(int slot, const aabb& box) {
+        min_x[slot] = box.min.x; min_y[slot] = box.min.y; min_z[slot] = box.min.z;
+        max_x[slot] = box.max.x; max_y[slot] = box.max.y; max_z[slot] = box.max.z;
+    }
+    aabb get_bounds(int slot) const {
+        return aabb { glm::vec3(min_x[slot], min_y[slot], min_z[slot]),
+                glm::vec3(max_x[slot], max_y[slot], max_z[slot]) };
+    }
+};
+
+struct bvh_hit {
+    uint32_t item;
+    float t;
+};
+
+class bvh4 {
+    public:
+        static constexpr uint32_t max_leaf_size = 4;
+        // below this many items a subtree is built on the calling thread
+        static constexpr uint32_t parallel_threshold = 16384;
+
+        std::vector<bvh4_node> nodes;
+        // item indices, grouped by leaf
+        std::vector<uint32_t> items;
+        // per item bounds; update in place and call refit() when objects move
+        std::vector<aabb> bounds;
+
+    private:
+        std::vector<glm::vec3> centroids;
+        std::unique_ptr<bvh4_node[]> build_nodes;
+        std::atomic<uint32_t> build_node_count;
+        thread_pool* pool = nullptr;
+
+        aabb range_bounds(uint32_t begin, uint32_t end) const {
+            auto box = aabb_empty();
+            for (auto i = begin; i < end; i++) box = aabb_union(box, bounds[items[i]]);
+            return box;
+        }
+
+        // binned SAH along the widest centroid axis; returns the partition point
+        uint32_t split_range(uint32_t begin, uint32_t end) {
+            const int bin_count = 16;
+            auto centroid_box = aabb_empty();
+            for (auto i = begin; i < end; i++) {
+                auto c = centroids[items[i]];
+                centroid_box.min = glm::min(centroid_box.min, c);
+                centroid_box.max = glm::max(centroid_box.max, c);
+            }
+
+            auto spread = centroid_box.max - centroid_box.min;
+            int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+            auto mid = begin + (end - begin) / 2;
+            auto lo = centroid_box.min[axis];
+            auto extent = spread[axis];
+            if (extent <= 1e-12f) return mid; // every centroid coincides
+            auto scale = bin_count / extent * 0.9999f;
+
+            float best_cost = 1e30f;
+            int best_bin = -1;
+            aabb bin_box[bin_count];
+            uint32_t bin_items[bin_count] = {};
+            for (auto& box : bin_box) box = aabb_empty();
+            for (auto i = begin; i < end; i++) {
+                int bin = (int)((centroids[items[i]][axis] - lo) * scale);
+                bin_box[bin] = aabb_union(bin_box[bin], bounds[items[i]]);
+                bin_items[bin]++;
+            }
+
+            float right_area[bin_count];
+            uint32_t right_items[bin_count];
+            auto box = aabb_empty();
+            uint32_t count = 0;
+            for (int bin = bin_count - 1; bin > 0; bin--) {
+                box = aabb_union(box, bin_box[bin]);
+                count += bin_items[bin];
+                right_area[bin] = box.surface_area();
+                right_items[bin] = count;
+            }
+            box = aabb_empty();
+            count = 0;
+            for (int bin = 0; bin < bin_count - 1; bin++) {
+                box = aabb_union(box, bin_box[bin]);
+                count += bin_items[bin];
+                if (count == 0 || right_items[bin + 1] == 0) continue;
+                auto cost = box.surface_area() * count + right_area[bin + 1] * right_items[bin + 1];
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_bin = bin;
+                }
+            }
+            if (best_bin < 0) return mid;
+
+            auto split = std::partition(items.begin() + begin, items.begin() + end, [&](uint32_t item) {
+                return (int)((centroids[item][axis] - lo) * scale) <= best_bin;
+            });
+            auto result = (uint32_t)(split - items.begin());
+            return result == begin || result == end ? mid : result;
+        }
+
+        void build_node(uint32_t index, uint32_t begin, uint32_t end) {
+            uint32_t range_begin[4] = { begin }, range_end[4] = { end };
+            int ranges = 1;
+            while (ranges < 4) {
+                int largest = -1;
+                uint32_t largest_count = max_leaf_size;
+                for (int i = 0; i < ranges; i++) {
+                    if (range_end[i] - range_begin[i] > largest_count) {
+                        largest = i;
+                        largest_count = range_end[i] - range_begin[i];
+                    }
+                }
+                if (largest < 0) break;
+                auto mid = split_range(range_begin[largest], range_end[largest]);
+                range_begin[ranges] = mid;
+                range_end[ranges] = range_end[largest];
+                range_end[largest] = mid;
+                ranges++;
+            }
+
+            auto& node = build_nodes[index];
+            uint32_t inner[4];
+            int inner_count = 0;
+            for (int slot = 0; slot < 4; slot++) {
+                if (slot >= ranges) {
+                    node.set_bounds(slot, aabb_empty());
+                    node.child[slot] = bvh_empty_slot;
+                    node.count[slot] = 0;
+                    continue;
+                }
+                node.set_bounds(slot, range_bounds(range_begin[slot], range_end[slot]));
+                auto count = range_end[slot] - range_begin[slot];
+                if (count <= max_leaf_size) {
+                    node.child[slot] = range_begin[slot];
+                    node.count[slot] = count;
+                } else {
+                    node.child[slot] = build_node_count.fetch_add(1);
+                    node.count[slot] = 0;
+                    inner[inner_count++] = slot;
+                }
+            }
+
+            auto build_child = [&](int i) {
+                auto slot = inner[i];
+                build_node(node.child[slot], range_begin[slot], range_end[slot]);
+            };
+            if (pool && end - begin > parallel_threshold) {
+                pool->parallel_for(inner_count, 1, [&](unsigned int from, unsigned int to) {
+                    for (auto i = from; i < to; i++) build_child(i);
+                });
+            } else {
+                for (int i = 0; i < inner_count; i++) build_child(i);
+            }
+        }
+
+        aabb refit_node(uint32_t index, int depth) {
+            auto& node = nodes[index];
+            aabb slot_bounds[4];
+            auto refit_slot = [&](int slot) {
+                if (node.is_leaf(slot)) {
+                    slot_bounds[slot] = aabb_empty();
+                    for (auto i = 0u; i < node.count[slot]; i++) {
+                        slot_bounds[slot] = aabb_union(slot_bounds[slot], bounds[items[node.child[slot] + i]]);
+                    }
+                } else if (node.is_inner(slot)) {
+                    slot_bounds[slot] = refit_node(node.child[slot], depth + 1);
+                } else {
+                    slot_bounds[slot] = aabb_empty();
+                }
+            };
+            // the top two levels fan out to up to 16 independent subtrees
+            if (pool && depth < 2 && items.size() > parallel_threshold) {
+                pool->parallel_for(4, 1, [&](unsigned int from, unsigned int to) {
+                    for (auto slot = from; slot < to; slot++) refit_slot(slot);
+                });
+            } else {
+                for (int slot = 0; slot < 4; slot++) refit_slot(slot);
+            }
+
+            auto box = aabb_empty();
+            for (int slot = 0; slot < 4; slot++) {
+                node.set_bounds(slot, slot_bounds[slot]);
+                box = aabb_union(box, slot_bounds[slot]);
+            }
+            return box;
+        }
+
+        void collect_subtree(uint32_t index, std::vector<uint32_t>& out) const {
+            const auto& node = nodes[index];
+            for (int slot = 0; slot < 4; slot++) {
+                if (node.is_leaf(slot)) {
+                    out.insert(out.end(), items.begin() + node.child[slot],
+                            items.begin() + node.child[slot] + node.count[slot]);
+                } else if (node.is_inner(slot)) {
+                    collect_subtree(node.child[slot], out);
+                }
+            }
+        }
+
+        void collect_slot(const bvh4_node& node, int slot, std::vector<uint32_t>& out) const {
+            if (node.is_leaf(slot)) {
+                out.insert(out.end(), items.begin() + node.child[slot],
+                        items.begin() + node.child[slot] + node.count[slot]);
+            } else if (node.is_inner(slot)) {
+                collect_subtree(node.child[slot], out);
+            }
+        }
+
+    public:
+        bvh4() : build_node_count(0) {}
+
+        void build(const std::vector<aabb>& item_bounds, thread_pool* pool = nullptr) {
+            this->pool = pool;
+            bounds = item_bounds;
+            auto count = (uint32_t)bounds.size();
+            items.resize(count);
+            centroids.resize(count);
+            for (uint32_t i = 0; i < count; i++) {
+                items[i] = i;
+                centroids[i] = bounds[i].center();
+            }
+            nodes.clear();
+            if (count == 0) return;
+
+            // every inner node has at least two children, so there are fewer
+            // inner nodes than items; the scratch is left uninitialized so
+            // untouched pages are never committed
+            build_nodes.reset(new bvh4_node[count]);
+            build_node_count = 1;
+            build_node(0, 0, count);
+            nodes.assign(build_nodes.get(), build_nodes.get() + build_node_count.load());
+            build_nodes.reset();
+            centroids.clear();
+            centroids.shrink_to_fit();
+        }
+
+        void refit(thread_pool* pool = nullptr) {
+            this->pool = pool;
+            if (!nodes.empty()) refit_node(0, 0);
+        }
+
+        aabb root_bounds() const {
+            auto box = aabb_empty();
+            if (nodes.empty()) return box;
+            for (int slot = 0; slot < 4; slot++) box = aabb_union(box, nodes[0].get_bounds(slot));
+            return box;
+        }
+
+        // appends every item whose bounds are at least partially inside
+        void query_frustum(const frustum& f, std::vector<uint32_t>& out) const {
+            if (nodes.empty()) return;
+            uint32_t stack[256];
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0) {
+                const auto& node = nodes[stack[--top]];
+                int outside = 0, intersects = 0;
+                for (const auto& plane : f.planes) {
+                    // per plane, the corner furthest along the normal decides
+                    // outside, the opposite corner decides partially inside
+                    auto px = plane.x > 0 ? node.max_x : node.min_x;
+                    auto py = plane.y > 0 ? node.max_y : node.min_y;
+                    auto pz = plane.z > 0 ? node.max_z : node.min_z;
+                    auto nx = plane.x > 0 ? node.min_x : node.max_x;
+                    auto ny = plane.y > 0 ? node.min_y : node.max_y;
+                    auto nz = plane.z > 0 ? node.min_z : node.max_z;
+#ifdef BVH_SSE
+                    auto a = _mm_set1_ps(plane.x), b = _mm_set1_ps(plane.y);
+                    auto c = _mm_set1_ps(plane.z), d = _mm_set1_ps(plane.w);
+                    auto positive = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, _mm_load_ps(px)), _mm_mul_ps(b, _mm_load_ps(py))),
+                            _mm_add_ps(_mm_mul_ps(c, _mm_load_ps(pz)), d));
+                    auto negative = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, _mm_load_ps(nx)), _mm_mul_ps(b, _mm_load_ps(ny))),
+                            _mm_add_ps(_mm_mul_ps(c, _mm_load_ps(nz)), d));
+                    outside |= _mm_movemask_ps(_mm_cmplt_ps(positive, _mm_setzero_ps()));
+                    intersects |= _mm_movemask_ps(_mm_cmplt_ps(negative, _mm_setzero_ps()));
+#else
+                    for (int slot = 0; slot < 4; slot++) {
+                        auto positive = plane.x * px[slot] + plane.y * py[slot] + plane.z * pz[slot] + plane.w;
+                        auto negative = plane.x * nx[slot] + plane.y * ny[slot] + plane.z * nz[slot] + plane.w;
+                        outside |= (positive < 0) << slot;
+                        intersects |= (negative < 0) << slot;
+                    }
+#endif
+                }
+                for (int slot = 0; slot < 4; slot++) {
+                    if (outside & (1 << slot)) continue;
+                    if (!(intersects & (1 << slot))) {
+                        collect_slot(node, slot, out);
+                    } else if (node.is_leaf(slot)) {
+                        for (auto i = 0u; i < node.count[slot]; i++) {
+                            auto item = items[node.child[slot] + i];
+                            if (frustum_test(f, bounds[item]) != cull_result::outside) out.push_back(item);
+                        }
+                    } else if (node.is_inner(slot)) {
+                        stack[top++] = node.child[slot];
+                    }
+                }
+            }
+        }
+
+        void query_aabb(const aabb& box, std::vector<uint32_t>& out) const {
+            if (nodes.empty()) return;
+            uint32_t stack[256];
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0) {
+                const auto& node = nodes[stack[--top]];
+                int overlap = 0;
+#ifdef BVH_SSE
+                auto hit = _mm_and_ps(
+                        _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.min_x), _mm_set1_ps(box.max.x)),
+                            _mm_cmpge_ps(_mm_load_ps(node.max_x), _mm_set1_ps(box.min.x))),
+                        _mm_and_ps(
+                            _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.min_y), _mm_set1_ps(box.max.y)),
+                                _mm_cmpge_ps(_mm_load_ps(node.max_y), _mm_set1_ps(box.min.y))),
+                            _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.min_z), _mm_set1_ps(box.max.z)),
+                                _mm_cmpge_ps(_mm_load_ps(node.max_z), _mm_set1_ps(box.min.z)))));
+                overlap = _mm_movemask_ps(hit);
+#else
+                for (int slot = 0; slot < 4; slot++) {
+                    overlap |= aabb_overlap(node.get_bounds(slot), box) << slot;
+                }
+#endif
+                for (int slot = 0; slot < 4; slot++) {
+                    if (!(overlap & (1 << slot))) continue;
+                    if (node.is_leaf(slot)) {
+                        for (auto i = 0u; i < node.count[slot]; i++) {
+                            auto item = items[node.child[slot] + i];
+                            if (aabb_overlap(bounds[item], box)) out.push_back(item);
+                        }
+                    } else if (node.is_inner(slot)) {
+                        stack[top++] = node.child[slot];
+                    }
+                }
+            }
+        }
+
+        // Closest hit along the ray. intersect(item, ray, max_t) returns the
+        // hit distance for that item, or a negative value on a miss; children
+        // are visited front to back so max_t shrinks as early as possible.
+        template <class F>
+        bvh_hit query_ray(const ray& r, float max_t, F&& intersect) const {
+            bvh_hit best { bvh_empty_slot, max_t };
+            if (nodes.empty()) return best;
+
+            auto inv = ray_inverse_direction(r);
+            struct entry { uint32_t node; float t; };
+            entry stack[256];
+            int top = 0;
+            stack[top++] = { 0, 0.f };
+            while (top > 0) {
+                auto current = stack[--top];
+                if (current.t > best.t) continue;
+                const auto& node = nodes[current.node];
+
+                float t_entry[4];
+                int hit_mask = 0;
+#ifdef BVH_SSE
+                auto ox = _mm_set1_ps(r.origin.x), oy = _mm_set1_ps(r.origin.y), oz = _mm_set1_ps(r.origin.z);
+                auto ix = _mm_set1_ps(inv.x), iy = _mm_set1_ps(inv.y), iz = _mm_set1_ps(inv.z);
+                auto x0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_x), ox), ix);
+                auto x1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_x), ox), ix);
+                auto y0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_y), oy), iy);
+                auto y1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_y), oy), iy);
+                auto z0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_z), oz), iz);
+                auto z1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_z), oz), iz);
+                auto t_near = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)),
+                        _mm_max_ps(_mm_min_ps(z0, z1), _mm_setzero_ps()));
+                auto t_far = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)),
+                        _mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(best.t)));
+                hit_mask = _mm_movemask_ps(_mm_cmple_ps(t_near, t_far));
+                _mm_storeu_ps(t_entry, t_near);
+#else
+                for (int slot = 0; slot < 4; slot++) {
+                    t_entry[slot] = ray_aabb(r, node.get_bounds(slot), best.t);
+                    hit_mask |= (t_entry[slot] >= 0.f) << slot;
+                }
+#endif
+                // push far children first so the nearest is popped next
+                int order[4], hits = 0;
+                for (int slot = 0; slot < 4; slot++) {
+                    if (!(hit_mask & (1 << slot)) || node.child[slot] == bvh_empty_slot) continue;
+                    int i = hits++;
+                    while (i > 0 && t_entry[order[i - 1]] < t_entry[slot]) {
+                        order[i] = order[i - 1];
+                        i--;
+                    }
+                    order[i] = slot;
+                }
+                for (int i = 0; i < hits; i++) {
+                    auto slot = order[i];
+                    if (node.is_inner(slot)) {
+                        stack[top++] = { node.child[slot], t_entry[slot] };
+                        continue;
+                    }
+                    for (auto k = 0u; k < node.count[slot]; k++) {
+                        auto item = items[node.child[slot] + k];
+                        auto t = intersect(item, r, best.t);
+                        if (t >= 0.f && t < best.t) best = bvh_hit { item, t };
+                    }
+                }
+            }
+            return best;
+        }
+
+        bvh_hit query_ray(const ray& r, float max_t) const {
+            return query_ray(r, max_t, [this](uint32_t item, const ray& r, float max_t) {
+                return ray_aabb(r, bounds[item], max_t);
+            });
+        }
+};
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+// Scripted camera flythroughs for repeatable benchmark views.
+//
+// A path is a list of keyframes in a small text file, one per line:
+//
+//   <seconds> <x> <y> <z> <yaw> <pitch> [label]
+//
+// with yaw and pitch in degrees, the same angles mouse look uses. Lines
+// starting with # are comments, and "step <seconds>" sets the fixed time
+// between played frames. Positions follow a Catmull-Rom spline through the
+// keyframes and rotations are slerped, so the camera passes every keyframe
+// exactly. Each keyframe starts a segment that collects the frame times
+// spent in it, so a slow view shows up under its label.
+
+// orientation mouse look produces for yaw and pitch in degrees
+inline glm::quat camera_look_rotation(double yaw, double pitch) {
+    auto direction = glm::vec3(
+            cos(glm::radians(yaw)) * cos(glm::radians(pitch)),
+            sin(glm::radians(pitch)),
+            sin(glm::radians(yaw)) * cos(glm::radians(pitch))
+            );
+    return glm::inverse(glm::quatLookAt(direction, glm::vec3(0, 1, 0)));
+}
+
+// world space step for an input direction in camera space
+inline glm::vec3 camera_move_delta(glm::vec3 input_direction, glm::quat rotation, float speed, float dt) {
+    return dt * speed * input_direction * rotation;
+}
+
+struct camera_keyframe {
+    float time;
+    glm::vec3 position;
+    glm::quat rotation;
+    std::string label;
+};
+
+struct camera_segment_stats {
+    unsigned int frames = 0;
+    double total = 0.0; // seconds
+    double worst = 0.0;
+};
+
+// uniform Catmull-Rom between p1 and p2
+inline glm::vec3 catmull_rom(glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec3 p3, float t) {
+    auto t2 = t * t;
+    auto t3 = t2 * t;
+    return 0.5f * ((2.f * p1) + (p2 - p0) * t + (2.f * p0 - 5.f * p1 + 4.f * p2 - p3) * t2
+            + (3.f * p1 - p0 - 3.f * p2 + p3) * t3);
+}
+
+class camera_path {
+    private:
+        std::vector<camera_keyframe> keys;
+        std::vector<camera_segment_stats> stats;
+        unsigned int frame = 0; // next to play; counted, not summed, so long paths don't drift
+
+        float frame_time(unsigned int i) const {
+            return std::min(keys.front().time + i * step, keys.back().time);
+        }
+
+        // played frames, the last one landing on the last keyframe
+        unsigned int frame_count() const {
+            return loaded() ? (unsigned int)std::ceil(duration() / step - 1e-3f) + 1 : 0;
+        }
+
+        // segment holding t, the one starting at the last keyframe at or before it
+        size_t segment_at(float t) const {
+            size_t i = 0;
+            while (i + 2 < keys.size() && keys[i + 1].time <= t) i++;
+            return i;
+        }
+
+    public:
+        float step = 1.f / 60.f; // seconds between played frames
+
+        // replaces the path; false, keeping nothing, when the text has no usable path
+        bool parse(const std::string& text, const char* name) {
+            keys.clear();
+            stats.clear();
+            frame = 0;
+            std::istringstream lines(text);
+            std::string line;
+            for (int number = 1; std::getline(lines, line); number++) {
+                std::istringstream fields(line);
+                std::string first;
+                if (!(fields >> first) || first[0] == '#') continue;
+                if (first == "step") {
+                    if (!(fields >> step) || step <= 0.f) {
+                        printf("[camera_path] Error: bad step on line {%d} of {%s}\n", number, name);
+                        step = 1.f / 60.f;
+                    }
+                    continue;
+                }
+                camera_keyframe key;
+                double yaw, pitch;
+                try {
+                    key.time = std::stof(first);
+                } catch (...) {
+                    key.time = -1.f;
+                }
+                if (!(fields >> key.position.x >> key.position.y >> key.position.z >> yaw >> pitch)
+                        || key.time < 0.f || (!keys.empty() && key.time <= keys.back().time)) {
+                    printf("[camera_path] Error: skipping line {%d} of {%s}, times have to increase\n", number, name);
+                    continue;
+                }
+                key.rotation = camera_look_rotation(yaw, pitch);
+                std::getline(fields >> std::ws, key.label);
+                keys.push_back(key);
+            }
+            if (keys.size() < 2) {
+                printf("[camera_path] Error: {%s} needs at least two keyframes\n", name);
+                keys.clear();
+                return false;
+            }
+            stats.resize(keys.size() - 1);
+            return true;
+        }
+
+        bool loaded() const { return !keys.empty(); }
+        bool finished() const { return frame >= frame_count(); }
+        float duration() const { return loaded() ? keys.back().time - keys.front().time : 0.f; }
+
+        void sample(float t, glm::vec3& position, glm::quat& rotation) const {
+            auto i = segment_at(t);
+            auto& a = keys[i];
+            auto& b = keys[i + 1];
+            auto f = glm::clamp((t - a.time) / (b.time - a.time), 0.f, 1.f);
+            // end keys are mirrored so the first and last segments get a tangent too
+            auto before = i > 0 ? keys[i - 1].position : 2.f * a.position - b.position;
+            auto after = i + 2 < keys.size() ? keys[i + 2].position : 2.f * b.position - a.position;
+            position = catmull_rom(before, a.position, b.position, after, f);
+            rotation = glm::slerp(a.rotation, b.rotation, f);
+        }
+
+        // camera for the next frame; false once the path is over
+        bool next(glm::vec3& position, glm::quat& rotation) {
+            if (finished()) return false;
+            sample(frame_time(frame++), position, rotation);
+            return true;
+        }
+
+        // seconds the frame last returned by next() took
+        void record(double seconds) {
+            if (!loaded() || !frame) return;
+            auto& s = stats[segment_at(frame_time(frame - 1))];
+            s.frames++;
+            s.total += seconds;
+            if (seconds > s.worst) s.worst = seconds;
+        }
+
+        void print_stats() const {
+            for (size_t i = 0; i < stats.size(); i++) {
+                auto& s = stats[i];
+                auto& label = keys[i].label;
+                printf("  segment {%zu} {%s}: {%u} frames, mean {%.3f} ms, worst {%.3f} ms\n", i,
+                        label.empty() ? "-" : label.c_str(), s.frames,
+                        s.frames ? 1000.0 * s.total / s.frames : 0.0, 1000.0 * s.worst);
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,11 @@
+#version 330 core
+in vec2 tex_coord;
+in vec4 vert_color;
+out vec4 frag_color;
+
+// glyph coverage in red, see overlay.h
+uniform sampler2D font;
+
+void main() {
+    frag_color = vec4(vert_color.rgb, vert_color.a * texture(font, tex_coord).r);
+}
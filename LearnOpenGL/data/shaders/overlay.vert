@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) in vec2 pos; // pixels from the top left
+layout (location = 1) in vec2 uv;
+layout (location = 2) in vec4 color;
+out vec2 tex_coord;
+out vec4 vert_color;
+
+uniform vec2 screen_size;
+
+void main() {
+    vec2 ndc = pos / screen_size * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+    tex_coord = uv;
+    vert_color = color;
+}
@@ -1,12 +1,52 @@
 #version 330 core
+#ifdef BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
 in vec3 vert_color;  
 in vec2 tex_coord;
 out vec4 frag_color;
 
-uniform sampler2D tex;
-uniform sampler2D tex2;
 uniform vec4 prog_color;
 
+vec4 sample_layer(sampler2DArray sampler, float layer, vec4 rect, vec2 uv) {
+    // whole layers keep the sampler's wrapping, atlas entries clamp to their rect
+    if (rect.zw != vec2(1.0)) uv = clamp(uv, 0.0, 1.0);
+    return texture(sampler, vec3(rect.xy + uv * rect.zw, layer));
+}
+
+#ifdef BINDLESS
+// one entry per texture id, see bindless.h
+struct texture_slot {
+    uvec2 handle;
+    float layer;
+    vec4 uv_rect;
+};
+layout (std140) uniform bindless_textures {
+    texture_slot slots[512];
+};
+uniform int tex;
+uniform int tex2;
+
+vec4 sample_texture(int id, vec2 uv) {
+    return sample_layer(sampler2DArray(slots[id].handle), slots[id].layer, slots[id].uv_rect, uv);
+}
+#else
+// each texture is a layer of an array, plus a rect when it was packed into an atlas page
+uniform sampler2DArray tex;
+uniform float tex_layer;
+uniform vec4 tex_rect;
+uniform sampler2DArray tex2;
+uniform float tex2_layer;
+uniform vec4 tex2_rect;
+#endif
+
 void main() {
-    frag_color = mix(texture(tex, tex_coord) * prog_color, texture(tex2, tex_coord * vec2(2.0, 2.0)) * prog_color * vec4(vert_color, 1.0), 0.5); 
+#ifdef BINDLESS
+    vec4 tex_color = sample_texture(tex, tex_coord);
+    vec4 tex2_color = sample_texture(tex2, tex_coord * vec2(2.0, 2.0));
+#else
+    vec4 tex_color = sample_layer(tex, tex_layer, tex_rect, tex_coord);
+    vec4 tex2_color = sample_layer(tex2, tex2_layer, tex2_rect, tex_coord * vec2(2.0, 2.0));
+#endif
+    frag_color = mix(tex_color * prog_color, tex2_color * prog_color * vec4(vert_color, 1.0), 0.5); 
 }
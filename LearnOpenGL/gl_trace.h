@@ -0,0 +1,273 @@
+#ifndef GL_TRACE_H
+#define GL_TRACE_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Instrumented GL dispatch, for finding driver overhead without external
+// tools. gl_trace_install() swaps every glad_ pointer that was loaded for a
+// wrapper that counts the call, times it, and forwards to the driver; the
+// list of entry points is gl_trace_functions.h. Only the LEARNOPENGL_GL_TRACE
+// build calls it, since timing every call costs more than the calls do.
+//
+// A call is redundant when it repeats the last call of the same state setter
+// with the same arguments, e.g. binding what is already bound. Setters whose
+// meaning depends on other state (glBindTexture on the active unit, glUniform
+// on the program in use, buffer and attribute state on the vertex array)
+// only compare since that state last changed. Enables and disables are
+// compared against the last value set for the same capability by either
+// one, so glEnable(X), glDisable(X), glEnable(X) repeats nothing. Calls with
+// pointer arguments can't be compared and never count as redundant.
+//
+// gl_trace_end_frame() closes a frame; with a histogram file open it writes
+// one CSV row per function called that frame.
+
+struct gl_trace_counter {
+    uint64_t calls = 0;
+    uint64_t redundant = 0;
+    uint64_t nanoseconds = 0; // spent in the driver
+};
+
+enum gl_trace_function {
+#define GL_TRACE_FUNCTION(name) gl_trace_##name,
+#include "gl_trace_functions.h"
+#undef GL_TRACE_FUNCTION
+    gl_trace_function_count
+};
+
+const char* const gl_trace_names[gl_trace_function_count] = {
+#define GL_TRACE_FUNCTION(name) #name,
+#include "gl_trace_functions.h"
+#undef GL_TRACE_FUNCTION
+};
+
+// what the last call of a state setter looked like
+struct gl_trace_setter {
+    bool tracked = false;
+    int depends = -1; // function whose calls invalidate the last call, or -1
+    bool has_last = false;
+    uint64_t last_hash = 0;
+    uint64_t last_depends_changes = 0;
+    uint64_t changes = 0; // calls that weren't redundant
+    int toggle_family = -1; // for enables and disables, the enable of the pair
+    bool enables = false;
+};
+
+// the last enable or disable of one capability
+struct gl_trace_toggle {
+    int family;
+    uint64_t hash; // of the arguments naming the capability
+    bool enabled;
+    uint64_t depends_changes;
+};
+
+struct gl_trace_state {
+    gl_trace_counter frame[gl_trace_function_count];
+    gl_trace_counter total[gl_trace_function_count];
+    gl_trace_setter setters[gl_trace_function_count];
+    std::vector<gl_trace_toggle> toggles; // few capabilities get set, so a list is enough
+    uint64_t frames = 0;
+    FILE* histogram = nullptr;
+};
+
+inline gl_trace_state gl_trace;
+
+typedef std::chrono::steady_clock gl_trace_clock;
+
+// FNV-1a over the arguments; pointers make a call incomparable
+struct gl_trace_args {
+    uint64_t hash = 14695981039346656037ull;
+    bool comparable = true;
+};
+
+template <typename T>
+inline void gl_trace_hash(gl_trace_args& key, const T& value) {
+    if (std::is_pointer<T>::value) {
+        key.comparable = false;
+        return;
+    }
+    unsigned char bytes[sizeof(T)];
+    memcpy(bytes, &value, sizeof(T));
+    for (auto b : bytes) {
+        key.hash ^= b;
+        key.hash *= 1099511628211ull;
+    }
+}
+
+inline void gl_trace_check_toggle(int id, const gl_trace_args& key, uint64_t depends_changes) {
+    auto& setter = gl_trace.setters[id];
+    for (auto& toggle : gl_trace.toggles) {
+        if (toggle.family != setter.toggle_family || toggle.hash != key.hash) continue;
+        if (toggle.enabled == setter.enables && toggle.depends_changes == depends_changes) {
+            gl_trace.frame[id].redundant++;
+            return;
+        }
+        toggle.enabled = setter.enables;
+        toggle.depends_changes = depends_changes;
+        setter.changes++;
+        return;
+    }
+    gl_trace.toggles.push_back(gl_trace_toggle { setter.toggle_family, key.hash, setter.enables, depends_changes });
+    setter.changes++;
+}
+
+inline void gl_trace_check_redundant(int id, const gl_trace_args& key) {
+    auto& setter = gl_trace.setters[id];
+    auto depends_changes = setter.depends >= 0 ? gl_trace.setters[setter.depends].changes : 0;
+    if (setter.toggle_family >= 0) {
+        if (key.comparable) gl_trace_check_toggle(id, key, depends_changes);
+        else setter.changes++;
+        return;
+    }
+    if (key.comparable && setter.has_last && setter.last_hash == key.hash
+            && setter.last_depends_changes == depends_changes) {
+        gl_trace.frame[id].redundant++;
+        return;
+    }
+    setter.has_last = key.comparable;
+    setter.last_hash = key.hash;
+    setter.last_depends_changes = depends_changes;
+    setter.changes++;
+}
+
+template <int id, typename Proc>
+struct gl_trace_hook;
+
+template <int id, typename R, typename... Args>
+struct gl_trace_hook<id, R (APIENTRYP)(Args...)> {
+    static inline R (APIENTRYP original)(Args...) = nullptr;
+
+    static R APIENTRY call(Args... args) {
+        if (gl_trace.setters[id].tracked) {
+            gl_trace_args key;
+            (gl_trace_hash(key, args), ...);
+            gl_trace_check_redundant(id, key);
+        }
+        auto& counter = gl_trace.frame[id];
+        counter.calls++;
+        auto start = gl_trace_clock::now();
+        if constexpr (std::is_void<R>::value) {
+            original(args...);
+            counter.nanoseconds += (gl_trace_clock::now() - start).count();
+        } else {
+            R result = original(args...);
+            counter.nanoseconds += (gl_trace_clock::now() - start).count();
+            return result;
+        }
+    }
+};
+
+template <int id, typename Proc>
+inline void gl_trace_wrap(Proc& pointer) {
+    if (!pointer) return; // not loaded, so it stays null for glad's checks
+    gl_trace_hook<id, Proc>::original = pointer;
+    pointer = &gl_trace_hook<id, Proc>::call;
+}
+
+inline bool gl_trace_starts_with(const char* name, const char* prefix) {
+    return !strncmp(name, prefix, strlen(prefix));
+}
+
+inline int gl_trace_find(const char* name) {
+    for (int i = 0; i < gl_trace_function_count; i++) {
+        if (!strcmp(gl_trace_names[i], name)) return i;
+    }
+    return -1;
+}
+
+// state setters whose repeats are worth reporting
+inline bool gl_trace_is_setter(const char* name) {
+    const char* prefixes[] = { "glBind", "glUseProgram", "glActiveTexture", "glEnable", "glDisable", "glUniform",
+        "glPolygonMode", "glBlendFunc", "glBlendEquation", "glDepthFunc", "glDepthMask", "glColorMask",
+        "glCullFace", "glFrontFace", "glViewport", "glScissor", "glClearColor", "glClearDepth", "glPixelStore" };
+    for (auto prefix : prefixes) {
+        if (gl_trace_starts_with(name, prefix)) return true;
+    }
+    return false;
+}
+
+// call once after gladLoadGLLoader, with the context current
+inline void gl_trace_install() {
+    for (int i = 0; i < gl_trace_function_count; i++) {
+        auto name = gl_trace_names[i];
+        auto& setter = gl_trace.setters[i];
+        setter.tracked = gl_trace_is_setter(name);
+        if (gl_trace_starts_with(name, "glBindTexture")) setter.depends = gl_trace_glActiveTexture;
+        else if (gl_trace_starts_with(name, "glUniform")) setter.depends = gl_trace_glUseProgram;
+        else if (gl_trace_starts_with(name, "glBindBuffer") || gl_trace_starts_with(name, "glEnableVertexAttrib")
+                || gl_trace_starts_with(name, "glDisableVertexAttrib")) setter.depends = gl_trace_glBindVertexArray;
+        // pairs like glEnablei and glDisablei share the last value per capability
+        std::string capability;
+        if (gl_trace_starts_with(name, "glEnable")) capability = name + strlen("glEnable");
+        else if (gl_trace_starts_with(name, "glDisable")) capability = name + strlen("glDisable");
+        else continue;
+        if (gl_trace_find(("glDisable" + capability).c_str()) < 0) continue;
+        setter.toggle_family = gl_trace_find(("glEnable" + capability).c_str());
+        setter.enables = gl_trace_starts_with(name, "glEnable");
+    }
+#define GL_TRACE_FUNCTION(name) gl_trace_wrap<gl_trace_##name>(glad_##name);
+#include "gl_trace_functions.h"
+#undef GL_TRACE_FUNCTION
+}
+
+// csv of frame, function, calls, redundant calls and microseconds in the driver
+inline bool gl_trace_open_histogram(const char* path) {
+    gl_trace.histogram = fopen(path, "w");
+    if (!gl_trace.histogram) {
+        printf("[gl_trace] Error: can't write {%s}\n", path);
+        return false;
+    }
+    fprintf(gl_trace.histogram, "frame,function,calls,redundant,microseconds\n");
+    return true;
+}
+
+inline void gl_trace_end_frame() {
+    for (int i = 0; i < gl_trace_function_count; i++) {
+        auto& frame = gl_trace.frame[i];
+        if (!frame.calls) continue;
+        if (gl_trace.histogram) {
+            fprintf(gl_trace.histogram, "%llu,%s,%llu,%llu,%.3f\n", (unsigned long long)gl_trace.frames,
+                    gl_trace_names[i], (unsigned long long)frame.calls, (unsigned long long)frame.redundant,
+                    frame.nanoseconds / 1e3);
+        }
+        auto& total = gl_trace.total[i];
+        total.calls += frame.calls;
+        total.redundant += frame.redundant;
+        total.nanoseconds += frame.nanoseconds;
+        frame = gl_trace_counter {};
+    }
+    gl_trace.frames++;
+}
+
+// the functions that took the most driver time, per frame on average
+inline void gl_trace_print_summary(unsigned int count = 20) {
+    std::vector<int> called;
+    for (int i = 0; i < gl_trace_function_count; i++) {
+        if (gl_trace.total[i].calls) called.push_back(i);
+    }
+    std::sort(called.begin(), called.end(), [](int a, int b) {
+        return gl_trace.total[a].nanoseconds > gl_trace.total[b].nanoseconds;
+    });
+    auto frames = (double)std::max<uint64_t>(gl_trace.frames, 1);
+    printf("GL calls over {%llu} frames, per frame:\n", (unsigned long long)gl_trace.frames);
+    for (size_t i = 0; i < called.size() && i < count; i++) {
+        auto& total = gl_trace.total[called[i]];
+        printf("  %-32s {%10.1f} calls {%10.1f} redundant {%9.3f} ms\n", gl_trace_names[called[i]],
+                total.calls / frames, total.redundant / frames, total.nanoseconds / 1e6 / frames);
+    }
+}
+
+inline void gl_trace_close() {
+    if (gl_trace.histogram) fclose(gl_trace.histogram);
+    gl_trace.histogram = nullptr;
+}
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef GPU_QUERIES_H
+#define GPU_QUERIES_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Per-pass GPU counters from query objects: primitives generated and samples
+// passed always, and with ARB_pipeline_statistics_query (core in 4.6) the
+// vertex and fragment shader invocations and the primitives going into and
+// out of clipping.
+//
+// Results are read frames later, once the GPU has them, so collecting never
+// stalls. Queries come from a pool and go back to it when read. When the GPU
+// falls further behind than the latency allows, frames are skipped rather
+// than waited for.
+//
+// Passes can't nest: every counter is its own query target and GL allows one
+// active query per target.
+
+enum gpu_counter {
+    gpu_primitives_generated,
+    gpu_samples_passed,
+    // pipeline statistics
+    gpu_vertices_submitted,
+    gpu_vertex_invocations,
+    gpu_fragment_invocations,
+    gpu_clipping_input,
+    gpu_clipping_output,
+    gpu_counter_count
+};
+
+const GLenum gpu_counter_targets[gpu_counter_count] = {
+    GL_PRIMITIVES_GENERATED,
+    GL_SAMPLES_PASSED,
+    GL_VERTICES_SUBMITTED,
+    GL_VERTEX_SHADER_INVOCATIONS,
+    GL_FRAGMENT_SHADER_INVOCATIONS,
+    GL_CLIPPING_INPUT_PRIMITIVES,
+    GL_CLIPPING_OUTPUT_PRIMITIVES,
+};
+
+const char* const gpu_counter_names[gpu_counter_count] = {
+    "primitives", "samples", "vertices", "vs invocations", "fs invocations", "clip in", "clip out",
+};
+
+inline bool gl_has_extension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        auto extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && !strcmp(extension, name)) return true;
+    }
+    return false;
+}
+
+struct gpu_pass_stats {
+    const char* name; // as passed to begin_pass()
+    uint64_t counters[gpu_counter_count];
+    bool has(gpu_counter c) const { return counters[c] != UINT64_MAX; }
+};
+
+class gpu_query_pool {
+    private:
+        struct pending_pass {
+            const char* name;
+            GLuint queries[gpu_counter_count];
+        };
+        struct pending_frame {
+            std::vector<pending_pass> passes;
+            bool issued = false;
+        };
+
+        std::vector<pending_frame> frames; // ring of latency frames in flight
+        std::vector<GLuint> free_queries;
+        std::vector<gpu_pass_stats> last;
+        unsigned int current = 0;
+        bool recording = false; // this frame got a slot
+        bool in_pass = false;
+        unsigned int counter_count = 0; // counters this context has, from the front of gpu_counter
+
+        GLuint acquire() {
+            if (free_queries.empty()) {
+                free_queries.resize(64);
+                glGenQueries(free_queries.size(), free_queries.data());
+            }
+            auto query = free_queries.back();
+            free_queries.pop_back();
+            return query;
+        }
+
+        bool available(const pending_frame& frame) const {
+            for (const auto& pass : frame.passes) {
+                for (unsigned int c = 0; c < counter_count; c++) {
+                    GLint ready = 0;
+                    glGetQueryObjectiv(pass.queries[c], GL_QUERY_RESULT_AVAILABLE, &ready);
+                    if (!ready) return false;
+                }
+            }
+            return true;
+        }
+
+        void read(pending_frame& frame) {
+            last.clear();
+            for (auto& pass : frame.passes) {
+                gpu_pass_stats stats { pass.name, {} };
+                for (unsigned int c = 0; c < gpu_counter_count; c++) {
+                    stats.counters[c] = UINT64_MAX;
+                    if (c >= counter_count) continue;
+                    GLuint64 value = 0;
+                    glGetQueryObjectui64v(pass.queries[c], GL_QUERY_RESULT, &value);
+                    stats.counters[c] = value;
+                    free_queries.push_back(pass.queries[c]);
+                }
+                last.push_back(stats);
+            }
+            frame.passes.clear();
+            frame.issued = false;
+            collected++;
+        }
+
+    public:
+        bool pipeline_statistics = false;
+        uint64_t collected = 0;
+        uint64_t skipped = 0; // frames that found every slot still in flight
+
+        // call with the context current
+        void init(unsigned int latency = 3) {
+            frames.assign(latency, pending_frame {});
+            pipeline_statistics = GLAD_GL_VERSION_4_6 || gl_has_extension("GL_ARB_pipeline_statistics_query");
+            counter_count = pipeline_statistics ? gpu_counter_count : gpu_vertices_submitted;
+        }
+
+        bool initialized() const { return !frames.empty(); }
+
+        void begin_frame() {
+            if (frames.empty()) return;
+            // oldest first, so results stay in frame order
+            for (unsigned int i = 0; i < frames.size(); i++) {
+                auto& frame = frames[(current + i) % frames.size()];
+                if (!frame.issued) continue;
+                if (!available(frame)) break;
+                read(frame);
+            }
+            recording = !frames[current].issued;
+            if (!recording) skipped++;
+        }
+
+        void begin_pass(const char* name) {
+            if (!recording || in_pass) return;
+            pending_pass pass { name, {} };
+            for (unsigned int c = 0; c < counter_count; c++) {
+                pass.queries[c] = acquire();
+                glBeginQuery(gpu_counter_targets[c], pass.queries[c]);
+            }
+            frames[current].passes.push_back(pass);
+            in_pass = true;
+        }
+
+        void end_pass() {
+            if (!in_pass) return;
+            for (unsigned int c = 0; c < counter_count; c++) glEndQuery(gpu_counter_targets[c]);
+            in_pass = false;
+        }
+
+        void end_frame() {
+            if (!recording) return;
+            end_pass();
+            frames[current].issued = !frames[current].passes.empty();
+            current = (current + 1) % frames.size();
+            recording = false;
+        }
+
+        // the passes of the newest frame read back, empty until one is
+        const std::vector<gpu_pass_stats>& results() const { return last; }
+
+        const gpu_pass_stats* find(const char* name) const {
+            for (const auto& pass : last) {
+                if (!strcmp(pass.name, name)) return &pass;
+            }
+            return nullptr;
+        }
+
+        // call while the context is still current
+        void release() {
+            for (auto& frame : frames) {
+                for (auto& pass : frame.passes) glDeleteQueries(counter_count, pass.queries);
+            }
+            if (!free_queries.empty()) glDeleteQueries(free_queries.size(), free_queries.data());
+            frames.clear();
+            free_queries.clear();
+            last.clear();
+            current = 0;
+            recording = in_pass = false;
+        }
+};
+
+#endif
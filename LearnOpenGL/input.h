@@ -0,0 +1,115 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+
+#include "glm/glm.hpp"
+#include "spsc_ring.h"
+
+// Event-driven input.
+//
+// GLFW callbacks only push timestamped events into an input_queue; the frame
+// drains it once into an input_state, which keeps what is held down plus
+// what was pressed or released since the last frame as bitsets. A tap that
+// starts and ends between two frames still shows up as pressed and released,
+// which polling with glfwGetKey would miss. Mouse buttons share the key space
+// after the last GLFW key, see input_mouse_button().
+//
+// Cursor events are only summed: a 1-8 kHz mouse sends many per frame, so
+// anything costly, like turning the camera, should read the frame's total
+// once instead of running per event.
+
+struct input_event {
+    enum kind : uint8_t { key, cursor, scroll };
+
+    double time; // glfwGetTime() when the callback ran
+    kind type;
+    int code;    // key or input_mouse_button() code
+    int action;  // GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT
+    glm::dvec2 xy; // cursor position or scroll offset
+};
+
+const int input_code_count = GLFW_KEY_LAST + 1 + GLFW_MOUSE_BUTTON_LAST + 1;
+
+constexpr int input_mouse_button(int button) {
+    return GLFW_KEY_LAST + 1 + button;
+}
+
+// events between two frames; a full queue drops new events and counts them
+class input_queue {
+    private:
+        spsc_ring<input_event, 1024> ring;
+
+    public:
+        std::atomic<uint32_t> dropped { 0 };
+
+        void push(const input_event& event) {
+            if (!ring.push(event)) dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        bool pop(input_event& event) { return ring.pop(event); }
+};
+
+class input_state {
+    private:
+        std::bitset<input_code_count> held;
+        std::bitset<input_code_count> pressed_edges;
+        std::bitset<input_code_count> released_edges;
+        bool has_cursor = false;
+
+    public:
+        glm::dvec2 cursor = glm::dvec2(0.0);       // last reported position
+        glm::dvec2 cursor_delta = glm::dvec2(0.0); // summed over the frame
+        unsigned int cursor_events = 0;            // this frame
+        double cursor_first_time = 0.0;            // timestamps of the frame's first and last cursor event
+        double cursor_last_time = 0.0;
+        glm::dvec2 scroll = glm::dvec2(0.0);       // summed over the frame
+        unsigned int events = 0;                   // applied this frame
+
+        // forgets the last frame's edges; held keys stay held
+        void begin_frame() {
+            pressed_edges.reset();
+            released_edges.reset();
+            cursor_delta = glm::dvec2(0.0);
+            cursor_events = 0;
+            scroll = glm::dvec2(0.0);
+            events = 0;
+        }
+
+        void apply(const input_event& event) {
+            events++;
+            switch (event.type) {
+            case input_event::key:
+                if (event.code < 0 || event.code >= input_code_count) return;
+                if (event.action == GLFW_PRESS) {
+                    held.set(event.code);
+                    pressed_edges.set(event.code);
+                } else if (event.action == GLFW_RELEASE) {
+                    held.reset(event.code);
+                    released_edges.set(event.code);
+                }
+                break;
+            case input_event::cursor:
+                if (!cursor_events++) cursor_first_time = event.time;
+                cursor_last_time = event.time;
+                // the first position ever reported is no motion from (0, 0)
+                if (has_cursor) cursor_delta += event.xy - cursor;
+                has_cursor = true;
+                cursor = event.xy;
+                break;
+            case input_event::scroll:
+                scroll += event.xy;
+                break;
+            }
+        }
+
+        bool down(int code) const { return held.test(code); }
+        bool pressed(int code) const { return pressed_edges.test(code); }
+        bool released(int code) const { return released_edges.test(code); }
+};
+
+#endif
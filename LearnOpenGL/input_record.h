@@ -0,0 +1,123 @@
+#ifndef INPUT_RECORD_H
+#define INPUT_RECORD_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+#include "mapped_file.h"
+
+// Records what the frame logic read each frame, plus the frame time, so a
+// camera path can be replayed exactly; benchmark runs then don't depend on
+// who held the mouse.
+//
+// The file is a small header followed by one fixed-size record per frame,
+// written as frames happen so an interrupted session still replays up to
+// where it stopped. Frame is stored as raw bytes, so it has to be trivially
+// copyable, and the header keeps its size to reject recordings made with a
+// different layout.
+
+const char input_record_magic[4] = { 'I', 'N', 'P', 'T' };
+const uint32_t input_record_version = 1;
+
+struct input_record_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t frame_size;
+    uint32_t reserved;
+};
+
+template <typename Frame>
+struct input_record {
+    static_assert(std::is_trivially_copyable<Frame>::value, "input frames are written as raw bytes");
+
+    float dT; // timestep the frame ran with
+    Frame frame;
+};
+
+template <typename Frame>
+class input_recorder {
+    private:
+        std::ofstream file;
+        uint64_t frames = 0;
+
+    public:
+        bool open(const char* path) {
+            file.open(path, std::ios::binary | std::ios::trunc);
+            if (!file) {
+                printf("[input_recorder] Error: can't write {%s}\n", path);
+                return false;
+            }
+            input_record_header header {};
+            memcpy(header.magic, input_record_magic, sizeof(input_record_magic));
+            header.version = input_record_version;
+            header.frame_size = sizeof(input_record<Frame>);
+            file.write((const char*)&header, sizeof(header));
+            frames = 0;
+            return true;
+        }
+
+        bool recording() const { return file.is_open(); }
+        uint64_t size() const { return frames; }
+
+        void record(float dT, const Frame& frame) {
+            if (!recording()) return;
+            input_record<Frame> item {};
+            item.dT = dT;
+            item.frame = frame;
+            file.write((const char*)&item, sizeof(item));
+            frames++;
+        }
+
+        void close() {
+            if (recording()) file.close();
+        }
+};
+
+template <typename Frame>
+class input_replay {
+    private:
+        mapped_file file;
+        size_t frames = 0;
+        size_t next_frame = 0;
+
+    public:
+        bool open(const char* path) {
+            frames = next_frame = 0;
+            input_record_header header;
+            if (!file.open(path) || file.size() < sizeof(header)) {
+                printf("[input_replay] Error: can't read {%s}\n", path);
+                return false;
+            }
+            memcpy(&header, file.data(), sizeof(header));
+            if (memcmp(header.magic, input_record_magic, sizeof(input_record_magic)) != 0
+                    || header.version != input_record_version
+                    || header.frame_size != sizeof(input_record<Frame>)) {
+                printf("[input_replay] Error: {%s} isn't a recording from this build\n", path);
+                file = mapped_file();
+                return false;
+            }
+            // a trailing partial record is from an interrupted session and is ignored
+            frames = (file.size() - sizeof(header)) / sizeof(input_record<Frame>);
+            return true;
+        }
+
+        bool playing() const { return next_frame < frames; }
+        size_t size() const { return frames; }
+        size_t position() const { return next_frame; }
+
+        // false once every recorded frame has been played
+        bool next(float& dT, Frame& frame) {
+            if (!playing()) return false;
+            input_record<Frame> item;
+            memcpy(&item, file.data() + sizeof(input_record_header) + next_frame * sizeof(item), sizeof(item));
+            next_frame++;
+            dT = item.dT;
+            frame = item.frame;
+            return true;
+        }
+};
+
+#endif
@@ -0,0 +1,321 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "mesh.h"
+
+// Level of detail: quadric error metric simplification (Garland & Heckbert)
+// run once at import time, and screen-space error based selection per frame.
+// Every level indexes into the same vertex buffer, so a chain is one index
+// buffer with an (offset, count) range per level.
+
+struct lod_level {
+    unsigned int index_offset;
+    unsigned int index_count;
+    float error; // object space distance from the full detail surface
+};
+
+struct lod_chain {
+    std::vector<unsigned int> indices;
+    std::vector<lod_level> levels;
+};
+
+// symmetric 4x4 error quadric, plus the accumulated weight so evaluation
+// yields a mean squared distance rather than an area-scaled sum
+struct quadric {
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+    double weight;
+};
+
+inline quadric make_plane_quadric(glm::vec3 n, float d, float weight) {
+    double a = n.x, b = n.y, c = n.z;
+    return quadric {
+        weight * a * a, weight * a * b, weight * a * c, weight * a * d,
+        weight * b * b, weight * b * c, weight * b * d,
+        weight * c * c, weight * c * d,
+        weight * d * d,
+        weight
+    };
+}
+
+inline void add_quadric(quadric& q, const quadric& r) {
+    q.a2 += r.a2; q.ab += r.ab; q.ac += r.ac; q.ad += r.ad;
+    q.b2 += r.b2; q.bc += r.bc; q.bd += r.bd;
+    q.c2 += r.c2; q.cd += r.cd;
+    q.d2 += r.d2;
+    q.weight += r.weight;
+}
+
+inline double quadric_error(const quadric& q, glm::vec3 p) {
+    double x = p.x, y = p.y, z = p.z;
+    double e = q.a2 * x * x + 2 * q.ab * x * y + 2 * q.ac * x * z + 2 * q.ad * x
+             + q.b2 * y * y + 2 * q.bc * y * z + 2 * q.bd * y
+             + q.c2 * z * z + 2 * q.cd * z
+             + q.d2;
+    return e > 0 ? e : 0;
+}
+
+namespace lod_detail {
+    struct collapse {
+        double cost;
+        unsigned int from, to;
+        unsigned int from_version, to_version;
+        bool operator<(const collapse& other) const { return cost > other.cost; }
+    };
+
+    // vertices sharing a position (uv/color seams) are simplified as one
+    inline std::vector<unsigned int> weld_positions(const mesh_data& mesh) {
+        std::vector<unsigned int> weld(mesh.vertex_count());
+        std::unordered_map<uint64_t, unsigned int> seen;
+        for (unsigned int i = 0; i < mesh.vertex_count(); i++) {
+            auto p = mesh.position(i);
+            uint32_t bits[3];
+            memcpy(bits, &p.x, sizeof(bits));
+            uint64_t key = (uint64_t)bits[0] * 73856093u ^ (uint64_t)bits[1] * 19349663u
+                ^ ((uint64_t)bits[2] << 32);
+            // hash collisions between distinct positions fall back to not welding
+            auto found = seen.find(key);
+            if (found != seen.end() && mesh.position(found->second) == p) {
+                weld[i] = found->second;
+            } else {
+                seen[key] = i;
+                weld[i] = i;
+            }
+        }
+        return weld;
+    }
+
+    inline glm::vec3 triangle_normal(glm::vec3 p0, glm::vec3 p1, glm::vec3 p2) {
+        return glm::cross(p1 - p0, p2 - p0);
+    }
+}
+
+// Collapses edges in order of increasing quadric error until the index count
+// drops to target_index_count or the next collapse would exceed max_error.
+// Collapses are half-edge (onto an existing vertex) so vertex attributes stay
+// valid without resampling. Returns the new index list; out_error receives the
+// largest error introduced.
+inline std::vector<unsigned int> simplify_mesh(const mesh_data& mesh,
+        const std::vector<unsigned int>& indices,
+        unsigned int target_index_count,
+        float max_error,
+        float* out_error) {
+    using namespace lod_detail;
+    const float boundary_weight = 10.f;
+
+    auto vertex_count = mesh.vertex_count();
+    auto weld = weld_positions(mesh);
+
+    // triangles keep their original corner indices; weld[] gives the collapse vertex
+    std::vector<unsigned int> tris;
+    tris.reserve(indices.size());
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        auto a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (weld[a] == weld[b] || weld[b] == weld[c] || weld[a] == weld[c]) continue;
+        tris.insert(tris.end(), { a, b, c });
+    }
+    auto tri_count = tris.size() / 3;
+    std::vector<bool> tri_dead(tri_count, false);
+    std::vector<std::vector<unsigned int>> adjacency(vertex_count);
+    std::vector<quadric> quadrics(vertex_count, quadric {});
+
+    std::unordered_map<uint64_t, int> edge_uses;
+    auto edge_key = [&](unsigned int a, unsigned int b) {
+        a = weld[a]; b = weld[b];
+        return a < b ? ((uint64_t)a << 32 | b) : ((uint64_t)b << 32 | a);
+    };
+
+    for (size_t t = 0; t < tri_count; t++) {
+        auto c = &tris[t * 3];
+        auto p0 = mesh.position(c[0]), p1 = mesh.position(c[1]), p2 = mesh.position(c[2]);
+        auto n = triangle_normal(p0, p1, p2);
+        auto area = 0.5f * glm::length(n);
+        if (area > 0.f) n = n / (2.f * area);
+        auto q = make_plane_quadric(n, -glm::dot(n, p0), area);
+        for (int k = 0; k < 3; k++) {
+            add_quadric(quadrics[weld[c[k]]], q);
+            adjacency[weld[c[k]]].push_back(t);
+            edge_uses[edge_key(c[k], c[(k + 1) % 3])]++;
+        }
+    }
+
+    // open edges get a perpendicular plane so the silhouette doesn't shrink away
+    for (size_t t = 0; t < tri_count; t++) {
+        auto c = &tris[t * 3];
+        auto face_n = triangle_normal(mesh.position(c[0]), mesh.position(c[1]), mesh.position(c[2]));
+        for (int k = 0; k < 3; k++) {
+            if (edge_uses[edge_key(c[k], c[(k + 1) % 3])] != 1) continue;
+            auto p0 = mesh.position(c[k]), p1 = mesh.position(c[(k + 1) % 3]);
+            auto edge = p1 - p0;
+            auto n = glm::cross(edge, face_n);
+            auto len = glm::length(n);
+            if (len <= 0.f) continue;
+            n = n / len;
+            auto q = make_plane_quadric(n, -glm::dot(n, p0), boundary_weight * glm::dot(edge, edge));
+            add_quadric(quadrics[weld[c[k]]], q);
+            add_quadric(quadrics[weld[c[(k + 1) % 3]]], q);
+        }
+    }
+
+    std::vector<unsigned int> version(vertex_count, 0);
+    std::vector<bool> removed(vertex_count, false);
+    std::priority_queue<collapse> heap;
+
+    auto error_of = [&](unsigned int from, unsigned int to) {
+        auto q = quadrics[from];
+        add_quadric(q, quadrics[to]);
+        auto e = quadric_error(q, mesh.position(to));
+        return q.weight > 0 ? e / q.weight : e;
+    };
+    auto push_edge = [&](unsigned int a, unsigned int b) {
+        auto ab = error_of(a, b);
+        auto ba = error_of(b, a);
+        if (ab <= ba) heap.push({ ab, a, b, version[a], version[b] });
+        else heap.push({ ba, b, a, version[b], version[a] });
+    };
+
+    for (size_t t = 0; t < tri_count; t++) {
+        auto c = &tris[t * 3];
+        for (int k = 0; k < 3; k++) {
+            auto a = weld[c[k]], b = weld[c[(k + 1) % 3]];
+            if (a < b || edge_uses[edge_key(a, b)] == 1) push_edge(a, b);
+        }
+    }
+
+    auto live_tris = tri_count;
+    double worst = 0;
+    while (live_tris * 3 > target_index_count && !heap.empty()) {
+        auto top = heap.top();
+        heap.pop();
+        if (removed[top.from] || removed[top.to]) continue;
+        if (version[top.from] != top.from_version || version[top.to] != top.to_version) continue;
+        if (max_error > 0.f && std::sqrt(top.cost) > max_error) break;
+
+        // reject collapses that fold a surviving triangle over
+        bool flips = false;
+        auto to_position = mesh.position(top.to);
+        for (auto t : adjacency[top.from]) {
+            if (tri_dead[t]) continue;
+            auto c = &tris[t * 3];
+            bool has_to = weld[c[0]] == top.to || weld[c[1]] == top.to || weld[c[2]] == top.to;
+            if (has_to) continue;
+            glm::vec3 p[3], moved[3];
+            for (int k = 0; k < 3; k++) {
+                p[k] = mesh.position(c[k]);
+                moved[k] = weld[c[k]] == top.from ? to_position : p[k];
+            }
+            auto before = triangle_normal(p[0], p[1], p[2]);
+            auto after = triangle_normal(moved[0], moved[1], moved[2]);
+            if (glm::dot(before, after) <= 0.f) {
+                flips = true;
+                break;
+            }
+        }
+        if (flips) continue;
+
+        add_quadric(quadrics[top.to], quadrics[top.from]);
+        removed[top.from] = true;
+        version[top.to]++;
+        worst = std::max(worst, top.cost);
+
+        for (auto t : adjacency[top.from]) {
+            if (tri_dead[t]) continue;
+            auto c = &tris[t * 3];
+            bool has_to = weld[c[0]] == top.to || weld[c[1]] == top.to || weld[c[2]] == top.to;
+            if (has_to) {
+                tri_dead[t] = true;
+                live_tris--;
+                continue;
+            }
+            for (int k = 0; k < 3; k++) {
+                if (weld[c[k]] == top.from) c[k] = top.to;
+            }
+            adjacency[top.to].push_back(t);
+        }
+        adjacency[top.from].clear();
+
+        // re-queue every edge around the merged vertex with its new cost
+        std::vector<unsigned int> neighbours;
+        for (auto t : adjacency[top.to]) {
+            if (tri_dead[t]) continue;
+            for (int k = 0; k < 3; k++) {
+                auto v = weld[tris[t * 3 + k]];
+                if (v == top.to) continue;
+                bool known = false;
+                for (auto n : neighbours) known |= n == v;
+                if (!known) neighbours.push_back(v);
+            }
+        }
+        for (auto n : neighbours) push_edge(top.to, n);
+    }
+
+    std::vector<unsigned int> result;
+    result.reserve(live_tris * 3);
+    for (size_t t = 0; t < tri_count; t++) {
+        if (tri_dead[t]) continue;
+        result.insert(result.end(), { tris[t * 3], tris[t * 3 + 1], tris[t * 3 + 2] });
+    }
+    if (out_error) *out_error = (float)std::sqrt(worst);
+    return result;
+}
+
+// Each level targets `reduction` of the previous level's triangles and is
+// simplified from it, so the error bound accumulates down the chain. Stops
+// early when the simplifier can no longer make meaningful progress.
+inline lod_chain build_lod_chain(const mesh_data& mesh, unsigned int max_levels = 6,
+        float reduction = 0.5f) {
+    lod_chain chain;
+    chain.indices = mesh.indices;
+    chain.levels.push_back({ 0, (unsigned int)mesh.indices.size(), 0.f });
+
+    std::vector<unsigned int> previous = mesh.indices;
+    float error = 0.f;
+    while (chain.levels.size() < max_levels) {
+        unsigned int target = (unsigned int)(previous.size() / 3 * reduction) * 3;
+        if (target < 3) break;
+
+        float level_error = 0.f;
+        auto simplified = simplify_mesh(mesh, previous, target, 0.f, &level_error);
+        if (simplified.empty() || simplified.size() > previous.size() * 0.95f) break;
+
+        error += level_error;
+        chain.levels.push_back({ (unsigned int)chain.indices.size(),
+                (unsigned int)simplified.size(), error });
+        chain.indices.insert(chain.indices.end(), simplified.begin(), simplified.end());
+        previous = std::move(simplified);
+    }
+    return chain;
+}
+
+// Picks the coarsest level whose error projects to at most max_error_pixels.
+// pixels_per_unit is the screen scale at the object's distance. Going coarser
+// needs the error to fit within (1 - hysteresis) of the threshold, so objects
+// sitting right at a boundary don't pop back and forth every frame.
+inline int select_lod(const lod_chain& chain, float pixels_per_unit, int current,
+        float max_error_pixels, float hysteresis) {
+    int last = (int)chain.levels.size() - 1;
+    current = glm::clamp(current, 0, last);
+
+    auto coarsest_within = [&](float limit) {
+        int level = 0;
+        while (level < last && chain.levels[level + 1].error * pixels_per_unit <= limit) level++;
+        return level;
+    };
+
+    auto coarser = coarsest_within(max_error_pixels * (1.f - hysteresis));
+    if (coarser > current) return coarser;
+    if (chain.levels[current].error * pixels_per_unit > max_error_pixels) {
+        return coarsest_within(max_error_pixels);
+    }
+    return current;
+}
+
+#endif
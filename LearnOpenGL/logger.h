@@ -0,0 +1,306 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "spsc_ring.h"
+
+// Asynchronous logging for hot paths and callbacks.
+//
+//   LOG_INFO("New FOV: {%f}", fov);
+//
+// A call site copies the format pointer, its arguments and a timestamp into
+// a fixed-size record on the calling thread's own spsc_ring, which costs tens
+// of nanoseconds. A background thread formats and writes the records in time
+// order about once a millisecond. Formats have to outlive the call, which
+// string literals do. String arguments are copied into the record, so they
+// may be temporary, and are truncated when long.
+//
+// Levels below LOG_MIN_LEVEL compile to nothing. The default drops debug in
+// builds with NDEBUG. Each call site logs at most log_rate_limit records a
+// second per thread, and its next record after that says how many were
+// dropped. A full ring drops records too; logger.dropped counts them.
+//
+// log_flush() blocks until everything logged so far is written. Errors
+// flush right away, since a crash often follows them.
+
+enum class log_level { debug, info, warning, error };
+
+#ifndef LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define LOG_MIN_LEVEL 1
+#else
+#define LOG_MIN_LEVEL 0
+#endif
+#endif
+
+const unsigned int log_rate_limit = 50; // records per second per call site and thread
+
+union log_value {
+    long long i;
+    unsigned long long u;
+    double d;
+    uint16_t text; // offset into log_record::text
+};
+
+struct log_record {
+    static const unsigned int max_args = 8;
+    static const unsigned int text_size = 160;
+    enum kind : uint8_t { signed_int, unsigned_int, floating, string, pointer };
+
+    uint64_t time; // steady clock nanoseconds
+    const char* format;
+    uint32_t suppressed; // records the rate limit dropped at this site just before this one
+    log_level level;
+    uint8_t count;
+    uint16_t text_used;
+    kind kinds[max_args];
+    log_value args[max_args];
+    char text[text_size];
+};
+
+// per call site and thread, see LOG_AT
+struct log_site {
+    uint64_t second = 0;
+    uint32_t count = 0;
+    uint32_t suppressed = 0;
+};
+
+inline uint64_t log_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void log_pack_string(log_record& r, log_value& arg, const char* s) {
+    if (r.text_used >= log_record::text_size) {
+        arg.text = log_record::text_size - 1; // the terminator of the last string
+        return;
+    }
+    auto length = std::min(strlen(s), (size_t)(log_record::text_size - 1 - r.text_used));
+    memcpy(r.text + r.text_used, s, length);
+    arg.text = r.text_used;
+    r.text_used += length;
+    r.text[r.text_used++] = 0;
+}
+
+template <typename T>
+inline void log_pack(log_record& r, const T& value) {
+    if (r.count == log_record::max_args) return;
+    auto& arg = r.args[r.count];
+    auto& kind = r.kinds[r.count++];
+    typedef typename std::decay<T>::type U;
+    if constexpr (std::is_array<T>::value && std::is_same<typename std::remove_cv<
+            typename std::remove_extent<T>::type>::type, char>::value) {
+        // char buffers and string literals, which can't be null
+        kind = log_record::string;
+        log_pack_string(r, arg, value);
+    } else if constexpr (std::is_same<U, char*>::value || std::is_same<U, const char*>::value) {
+        kind = log_record::string;
+        log_pack_string(r, arg, value ? value : "(null)");
+    } else if constexpr (std::is_pointer<U>::value) {
+        arg.u = (unsigned long long)(uintptr_t)value;
+        kind = log_record::pointer;
+    } else if constexpr (std::is_floating_point<U>::value) {
+        arg.d = value;
+        kind = log_record::floating;
+    } else if constexpr (std::is_enum<U>::value || std::is_signed<U>::value) {
+        arg.i = (long long)value;
+        kind = log_record::signed_int;
+    } else {
+        arg.u = (unsigned long long)value;
+        kind = log_record::unsigned_int;
+    }
+}
+
+// printf for one record, taking each conversion's argument from the record
+// instead of a va_list; length modifiers in the format are ignored
+inline void log_format(const log_record& r, char* out, size_t size) {
+    size_t used = 0;
+    unsigned int next = 0;
+    auto put = [&](int written) { if (written > 0) used = std::min(used + written, size - 1); };
+    for (const char* f = r.format; *f && used + 1 < size; f++) {
+        if (*f != '%') {
+            out[used++] = *f;
+            continue;
+        }
+        if (f[1] == '%') {
+            out[used++] = '%';
+            f++;
+            continue;
+        }
+        // flags, width and precision are kept, length modifiers replaced
+        char spec[32] = "%";
+        size_t length = 1;
+        for (f++; *f && strchr("-+ #0123456789.", *f) && length < 24; f++) spec[length++] = *f;
+        while (*f && strchr("hlLqjzt", *f)) f++;
+        if (!*f) break;
+        auto conversion = *f;
+        auto room = size - used;
+        if (next >= r.count) {
+            put(snprintf(out + used, room, "<?>"));
+            continue;
+        }
+        auto kind = r.kinds[next];
+        auto arg = r.args[next++];
+        if (strchr("diouxXc", conversion)) {
+            if (conversion != 'c') {
+                spec[length++] = 'l';
+                spec[length++] = 'l';
+            }
+            spec[length++] = conversion;
+            spec[length] = 0;
+            auto integer = kind == log_record::floating ? (long long)arg.d : arg.i;
+            if (conversion == 'c') put(snprintf(out + used, room, spec, (int)integer));
+            else put(snprintf(out + used, room, spec, integer));
+        } else if (strchr("fFeEgGaA", conversion)) {
+            spec[length++] = conversion;
+            spec[length] = 0;
+            auto real = kind == log_record::floating ? arg.d
+                    : kind == log_record::signed_int ? (double)arg.i : (double)arg.u;
+            put(snprintf(out + used, room, spec, real));
+        } else if (conversion == 's') {
+            spec[length++] = 's';
+            spec[length] = 0;
+            put(snprintf(out + used, room, spec, kind == log_record::string ? r.text + arg.text : "<?>"));
+        } else if (conversion == 'p') {
+            put(snprintf(out + used, room, "%p", (void*)(uintptr_t)arg.u));
+        }
+    }
+    out[used] = 0;
+}
+
+class async_logger {
+    private:
+        typedef spsc_ring<log_record, 512> ring;
+
+        std::mutex rings_mutex; // registering a thread, and draining
+        std::vector<std::unique_ptr<ring>> rings;
+        std::vector<log_record> batch; // drain only
+        std::thread writer;
+        std::atomic<bool> running { false };
+        std::atomic<bool> stopped { false };
+
+        void write(const log_record& r) {
+            char line[512];
+            log_format(r, line, sizeof(line));
+            auto file = r.level >= log_level::warning ? stderr : stdout;
+            if (r.suppressed) fprintf(file, "(%u similar messages dropped)\n", r.suppressed);
+            if (r.level == log_level::error) fprintf(file, "[LearnOpenGL] ERROR: ");
+            fprintf(file, "%s\n", line);
+        }
+
+        void drain() {
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            batch.clear();
+            log_record r;
+            for (auto& queue : rings) {
+                while (queue->pop(r)) batch.push_back(r);
+            }
+            // each ring is in order already; this interleaves the threads
+            std::stable_sort(batch.begin(), batch.end(), [](const log_record& a, const log_record& b) {
+                return a.time < b.time;
+            });
+            for (const auto& record : batch) write(record);
+            if (!batch.empty()) {
+                fflush(stdout);
+                fflush(stderr);
+            }
+        }
+
+        ring* thread_ring() {
+            thread_local ring* mine = nullptr;
+            if (mine) return mine;
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            rings.emplace_back(new ring());
+            mine = rings.back().get();
+            if (!running.exchange(true)) {
+                batch.reserve(ring::capacity()); // keeps the writer off the heap once it runs
+                writer = std::thread([this]() {
+                    while (running.load(std::memory_order_acquire)) {
+                        drain();
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    }
+                    drain();
+                });
+            }
+            return mine;
+        }
+
+    public:
+        std::atomic<uint64_t> dropped { 0 }; // records that found their ring full
+
+        ~async_logger() { stop(); }
+
+        template <typename... Args>
+        void log(log_level level, log_site* site, const char* format, const Args&... args) {
+            log_record r;
+            r.time = log_now();
+            r.format = format;
+            r.level = level;
+            r.count = 0;
+            r.text_used = 0;
+            r.suppressed = 0;
+            if (site) {
+                auto second = r.time / 1000000000ull;
+                if (second != site->second) {
+                    site->second = second;
+                    site->count = 0;
+                }
+                if (++site->count > log_rate_limit) {
+                    site->suppressed++;
+                    return;
+                }
+                r.suppressed = site->suppressed;
+                site->suppressed = 0;
+            }
+            (log_pack(r, args), ...);
+            if (stopped.load(std::memory_order_acquire)) {
+                // after shutdown, e.g. from other static destructors
+                write(r);
+                return;
+            }
+            if (!thread_ring()->push(r)) dropped.fetch_add(1, std::memory_order_relaxed);
+            if (level == log_level::error) flush();
+        }
+
+        // everything pushed before this call is written when it returns
+        void flush() {
+            if (running.load(std::memory_order_acquire)) drain();
+        }
+
+        // drains and joins the writer; later records are written synchronously
+        void stop() {
+            if (stopped.exchange(true)) return;
+            if (running.exchange(false)) writer.join();
+            drain();
+        }
+};
+
+inline async_logger logger;
+
+inline void log_flush() { logger.flush(); }
+
+#define LOG_AT(level, ...) \
+    do { \
+        if constexpr ((int)(level) >= LOG_MIN_LEVEL) { \
+            static thread_local log_site log_call_site; \
+            logger.log(level, &log_call_site, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(log_level::debug, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(log_level::info, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_AT(log_level::warning, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(log_level::error, __VA_ARGS__)
+
+#endif
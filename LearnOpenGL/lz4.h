@@ -0,0 +1,113 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Self-contained codec for the LZ4 block format (token, literals, 16-bit
+// offset, match length), so archives don't need the lz4 library.
+//
+// The compressor is a plain greedy matcher with a 64K-entry hash table; it
+// runs offline in the asset packer, so it favours simplicity over speed.
+// The decompressor checks every read and write against the buffer ends, so
+// a corrupt archive fails to decode instead of overrunning memory.
+
+inline size_t lz4_bound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+// dst needs lz4_bound(size) bytes; returns the compressed size
+inline size_t lz4_compress(const unsigned char* src, size_t size, unsigned char* dst) {
+    // the format wants the last 5 bytes as literals and no match starting in the last 12
+    const size_t last_literals = 5, match_limit = 12, min_match = 4;
+    auto out = dst;
+    size_t anchor = 0;
+
+    auto write_length = [&out](size_t length) {
+        for (; length >= 255; length -= 255) *out++ = 255;
+        *out++ = (unsigned char)length;
+    };
+    auto emit = [&](size_t literal_end, size_t offset, size_t match_length) {
+        auto literals = literal_end - anchor;
+        auto token = out++;
+        *token = (unsigned char)((literals >= 15 ? 15 : literals) << 4);
+        if (literals >= 15) write_length(literals - 15);
+        memcpy(out, src + anchor, literals);
+        out += literals;
+        if (!match_length) return;
+        *out++ = (unsigned char)offset;
+        *out++ = (unsigned char)(offset >> 8);
+        auto extra = match_length - min_match;
+        *token |= (unsigned char)(extra >= 15 ? 15 : extra);
+        if (extra >= 15) write_length(extra - 15);
+    };
+    auto read32 = [src](size_t i) {
+        uint32_t v;
+        memcpy(&v, src + i, 4);
+        return v;
+    };
+
+    if (size > match_limit) {
+        std::vector<uint32_t> table(1 << 16, 0); // position + 1, 0 for empty
+        for (size_t i = 0; i < size - match_limit;) {
+            auto sequence = read32(i);
+            auto& slot = table[(sequence * 2654435761u) >> 16];
+            auto candidate = (size_t)slot;
+            slot = (uint32_t)(i + 1);
+            if (!candidate || i - (candidate - 1) > 65535 || read32(candidate - 1) != sequence) {
+                i++;
+                continue;
+            }
+            candidate--;
+            auto length = min_match;
+            while (i + length < size - last_literals && src[candidate + length] == src[i + length]) length++;
+            emit(i, i - candidate, length);
+            i += length;
+            anchor = i;
+        }
+    }
+    emit(size, 0, 0);
+    return out - dst;
+}
+
+// true only when src decodes to exactly dst_size bytes
+inline bool lz4_decompress(const unsigned char* src, size_t src_size, unsigned char* dst, size_t dst_size) {
+    size_t in = 0, out = 0;
+    auto read_length = [&](size_t& length) {
+        unsigned char byte;
+        do {
+            if (in >= src_size) return false;
+            byte = src[in++];
+            length += byte;
+        } while (byte == 255);
+        return true;
+    };
+
+    while (in < src_size) {
+        auto token = src[in++];
+        size_t literals = token >> 4;
+        if (literals == 15 && !read_length(literals)) return false;
+        if (literals > src_size - in || literals > dst_size - out) return false;
+        memcpy(dst + out, src + in, literals);
+        in += literals;
+        out += literals;
+        if (in == src_size) break; // the last sequence has no match
+
+        if (src_size - in < 2) return false;
+        size_t offset = src[in] | (src[in + 1] << 8);
+        in += 2;
+        if (offset == 0 || offset > out) return false;
+        size_t length = token & 15;
+        if (length == 15 && !read_length(length)) return false;
+        length += 4;
+        if (length > dst_size - out) return false;
+        // byte by byte: matches may overlap their own output
+        for (size_t i = 0; i < length; i++) dst[out + i] = dst[out - offset + i];
+        out += length;
+    }
+    return out == dst_size;
+}
+
+#endif
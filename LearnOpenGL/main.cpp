@@ -1,5 +1,7 @@
 #include <stdio.h>
+#include <string.h>
 #include <iostream>
+#include <random>
 #include <glad/glad.h> 
 #include <GLFW/glfw3.h>
 
@@ -7,44 +9,124 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "allocators.h"
+#include "archive.h"
 #include "assrt.h"
+#include "bench.h"
+#include "bindless.h"
+#include "bounds.h"
+#include "bvh.h"
+#include "camera_path.h"
+#ifdef LEARNOPENGL_GL_TRACE
+#include "gl_trace.h"
+#endif
 #include "glm/common.hpp"
 #include "glm/ext/matrix_transform.hpp"
 #include "glm/ext/quaternion_transform.hpp"
 #include "glm/fwd.hpp"
 #include "glm/geometric.hpp"
 #include "glm/gtc/quaternion.hpp"
+#include "gpu_queries.h"
+#include "input.h"
+#include "input_record.h"
+#include "lod.h"
+#include "logger.h"
+#include "mesh.h"
+#include "occlusion.h"
+#include "overlay.h"
+#include "picking.h"
+#include "resources.h"
+#include "sampler.h"
 #include "shader.h"
+#include "spatial_grid.h"
+#include "texture_array.h"
+#include "texture_residency.h"
+#include "thread_pool.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image/stb_image.h"
 
+#define ALLOCATION_TRACKING_IMPLEMENTATION
+#include "allocators.h"
+
 bool verbose = true;
 
+// everything under data/ packed by the pack_data target; loose files are the fallback
+const char* archive_path = "data.pak";
 const char* vert_path = "data/shaders/shader.vert";
 const char* frag_path = "data/shaders/shader.frag";
+const char* overlay_vert_path = "data/shaders/overlay.vert";
+const char* overlay_frag_path = "data/shaders/overlay.frag";
+// replaces the #version line of the shaders when bindless textures are available
+const char* bindless_shader_header = "#version 400 core\n#define BINDLESS 1\n";
 const char* image_path = "data/images/container.jpeg";
 const char* image2_path = "data/images/awesomeface.png";
 
+// keys and buttons the frame reads, one input_frame bit each
+enum input_binding {
+    bind_quit,
+    bind_wireframe,
+    bind_perspective,
+    bind_occlusion,
+    bind_grid,
+    bind_pick,
+    bind_look,
+    bind_forward, bind_left, bind_back, bind_right, bind_down, bind_up,
+    bind_overlay, // after the rest so recorded input keeps its bits
+    binding_count
+};
+
+const int input_bindings[binding_count] = {
+    GLFW_KEY_ESCAPE,
+    GLFW_KEY_SPACE,
+    GLFW_KEY_P,
+    GLFW_KEY_O,
+    GLFW_KEY_G,
+    input_mouse_button(GLFW_MOUSE_BUTTON_LEFT),
+    input_mouse_button(GLFW_MOUSE_BUTTON_RIGHT),
+    GLFW_KEY_W, GLFW_KEY_A, GLFW_KEY_S, GLFW_KEY_D, GLFW_KEY_Q, GLFW_KEY_E,
+    GLFW_KEY_F3,
+};
+
 struct input_frame {
-    int space;
-    int p;
-    int w,a,s,d,q,e;
-    int l_mouse, r_mouse;
-
-    // mouse
-    glm::vec2 mouse_xy;
-    glm::vec2 mouse_delta;
+    uint32_t down;    // held at the end of the frame, bit per input_binding
+    uint32_t pressed; // went down since the last frame, even if already released again
+
+    bool held(input_binding binding) const { return down & (1u << binding); }
+    bool tapped(input_binding binding) const { return pressed & (1u << binding); }
+
+    glm::vec2 cursor;      // window coordinates at the end of the frame
+    // cursor scaled by mouse_sens, which makes it yaw and pitch in degrees
+    glm::dvec2 look_xy;    // where it last was with bind_look held, double like the callbacks
+    bool looked;           // look_xy changed this frame
+    float scroll;          // vertical wheel steps
 };
 
+// --record <file> saves every frame's input, --replay <file> plays one back
+// with its recorded timesteps instead of live input and the wall clock
+const char* input_record_path = nullptr;
+const char* input_replay_path = nullptr;
+// --path <file> flies the camera along a scripted path instead, see camera_path.h
+const char* camera_path_file = nullptr;
+// --gl-trace <file> writes per-frame GL call counts, in builds with gl_trace.h
+const char* gl_trace_path = nullptr;
+
 struct program_state {
     // options
     bool wireframe;
     bool perspective;
+    bool occlusion_culling;
+    bool grid_culling; // loose grid instead of the bvh
+    bool bindless; // ARB_bindless_texture handles instead of bound arrays, set at init
+    bool texture_streaming; // start from the small mips, stream finer ones as objects come closer
+    bool raw_mouse; // --raw-mouse: unaccelerated mouse motion where the platform supports it
+    bool overlay; // performance overlay, see draw_overlay()
 
     float camera_speed;
     float mouse_sens;
     float fov;
+    float lod_error_pixels; // max screen-space error before a finer lod is used
+    float lod_hysteresis;
 
     float width;
     float height;
@@ -55,7 +137,7 @@ struct program_state {
 
     // timings
     float dT;
-    float last_frame_time;
+    float frame_time; // clock this frame runs at
 
     // input
     input_frame last_input_frame;
@@ -64,14 +146,113 @@ struct program_state {
 program_state state = (program_state) {
     .perspective = true,
     .wireframe = false,
+    .occlusion_culling = true,
+    .grid_culling = false,
+    .bindless = false,
+    .texture_streaming = true,
+    .raw_mouse = false,
+    .overlay = false,
     .camera_speed = 10,
     .mouse_sens = 0.1f,
     .fov = 45.f,
+    .lod_error_pixels = 1.f,
+    .lod_hysteresis = 0.25f,
     .width = 800,
     .height = 800,
     .camera_position = glm::vec3(0.f, 0.f, -0.3f),
 };
 
+// the benchmarks swap in generated scenes, see build_scene()
+std::vector<glm::vec3> cube_positions = {
+    glm::vec3( 0.0f,  0.0f,  0.0f ), 
+    glm::vec3( 2.0f,  5.0f, -15.0f ), 
+    glm::vec3(-1.5f, -2.2f, -2.5f),  
+    glm::vec3(-3.8f, -2.0f, -12.3f),  
+    glm::vec3( 2.4f, -0.4f, -3.5f ),  
+    glm::vec3(-1.7f,  3.0f, -7.5f),  
+    glm::vec3( 1.3f, -2.0f, -2.5f ),  
+    glm::vec3( 1.5f,  2.0f, -2.5f ), 
+    glm::vec3( 1.5f,  0.2f, -1.5f ), 
+    glm::vec3(-1.3f,  1.0f, -1.5f)  
+};
+int cube_count = 0; // cube_positions.size() as of the last build_scene()
+
+// generated in render_init; lods are kept per object for hysteresis
+mesh_data pyramid_mesh;
+lod_chain pyramid_lods;
+aabb pyramid_bounds;
+glm::vec3 pyramid_center;
+float pyramid_radius;
+float pyramid_uv_density;
+packed_mesh pyramid_triangles;
+std::vector<int> cube_lods;
+std::vector<bool> cube_occluders;
+
+// object bounds in world space; refit when cube_positions change
+bvh4 scene_bvh;
+std::vector<uint32_t> visible_objects;
+
+// per-frame lists live here instead of the heap; the tracker checks that frames stay off it
+frame_arena frame_memory(1 << 20);
+allocation_tracker heap_tracker;
+
+// glfw callbacks push here, read_input drains it once per frame
+input_queue input_events;
+input_state input;
+input_recorder<input_frame> recorder;
+input_replay<input_frame> replay;
+camera_path flythrough;
+
+// what the last frame submitted, for the benchmarks
+struct render_stats {
+    unsigned int visible; // objects past the frustum, before occlusion culling
+    unsigned int draw_calls;
+    unsigned int state_changes; // binds and uniform uploads
+    uint64_t triangles;
+};
+render_stats frame_stats;
+
+struct draw_item {
+    uint32_t object;
+    float distance; // sort key, front to back so early depth tests reject more
+};
+
+// same objects bucketed for cheap per-frame moves
+loose_grid scene_grid(4.f);
+
+// every image lives in a layer of a few texture arrays, bound once per frame
+struct material {
+    unsigned int diffuse; // ids from textures.add()
+    unsigned int overlay;
+};
+texture_arrays textures;
+// shared by every texture unit; arrays only carry a sampler_desc
+sampler_cache samplers;
+bindless_textures bindless;
+// bindless handles freeze their texture's storage, so residency only runs without them
+texture_residency residency(256u << 20);
+material pyramid_material;
+
+// gl objects that outlive a single function; released through fences at shutdown
+resource_manager resources;
+mesh_handle pyramid_gpu;
+program_handle shader_program;
+double last_program_check = 0.0; // sources are polled twice a second for hot reloading
+
+// drawn over the finished frame; the frame is timed on the GPU only while it is shown
+perf_overlay overlay;
+overlay_history overlay_timings;
+gpu_frame_timer overlay_gpu_timer;
+gpu_query_pool gpu_queries; // per-pass counters, also only while the overlay is shown
+program_handle overlay_program;
+const GLuint overlay_texture_unit = 15; // clear of the texture array units
+double overlay_ms = 0.0; // its own CPU cost last frame
+double overlay_worst_ms = 0.0;
+
+thread_pool workers;
+asset_vfs assets;
+occlusion_buffer occlusion(128, 128, &workers);
+
 static void gl_debug_messenger([[maybe_unused]] GLenum source, GLenum type,
         [[maybe_unused]] GLuint id, GLenum severity,
         [[maybe_unused]] GLsizei length,
@@ -130,103 +311,200 @@ static void gl_debug_messenger([[maybe_unused]] GLenum source, GLenum type,
         return;
     }
 
-    printf("GL: [%s] [%s] %s\n", type_str, severity_str, message);
+    // message only lives as long as the callback; the logger copies it
+    LOG_WARNING("GL: [%s] [%s] %s", type_str, severity_str, message);
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     state.height = height;
     state.width = width;
     glViewport(0, 0, width, height);
-    if (verbose) printf("GLFW: Resized to : (%d, %d)\n", width, height); 
+    if (verbose) LOG_INFO("GLFW: Resized to : (%d, %d)", width, height);
 }
 
 void verbose_toggle(const char* var_name, bool var_value) {
-    if (verbose) printf("%s: {%s}\n", var_name, (var_value ? "ON" : "OFF"));
+    if (verbose) LOG_INFO("%s: {%s}", var_name, (var_value ? "ON" : "OFF"));
 }
 
 glm::vec3 position_delta_with_rotation(glm::vec3 input_direction) {
-    return state.dT * state.camera_speed * input_direction * state.camera_rotation; 
+    return camera_move_delta(input_direction, state.camera_rotation, state.camera_speed, state.dT);
 }
 
-void process_mouse_input(GLFWwindow* window, double x, double y) {
-    x *= state.mouse_sens;
-    y *= -state.mouse_sens;
-    auto xy = glm::vec2(x, y);
-    auto delta = xy - state.last_input_frame.mouse_xy;
-    delta = 0.1f * delta;
-    auto up = glm::vec3(0, 1, 0);
-   
-    if (state.last_input_frame.r_mouse == GLFW_PRESS) {
-        auto direction = glm::vec3(
-                cos(glm::radians(x)) * cos(glm::radians(y)),
-                sin(glm::radians(y)),
-                sin(glm::radians(x)) * cos(glm::radians(y))
-                );
-        state.camera_rotation = glm::inverse(glm::quatLookAt(direction, up));
-    }
-    state.last_input_frame.mouse_delta = delta; 
-    state.last_input_frame.mouse_xy = xy;
+glm::dvec2 scaled_cursor(glm::dvec2 cursor) {
+    return glm::dvec2(cursor.x * state.mouse_sens, cursor.y * -state.mouse_sens);
+}
+
+// the look is absolute in the cursor position, so resolving it once from the
+// frame's last looking position ends up where per-event updates would
+void process_mouse_input(GLFWwindow* window, const input_frame* frame) {
+    if (!frame->looked) return;
+    state.camera_rotation = camera_look_rotation(frame->look_xy.x, frame->look_xy.y);
+}
+
+glm::mat4 camera_view();
+glm::mat4 camera_projection();
+
+// triangle packets tested per pick before falling back to object bounds
+const unsigned int pick_packet_budget = 4096;
+
+// the cursor in normalized device coordinates, or the center of the view
+// while the cursor is captured for mouse look
+glm::vec2 pick_ndc(GLFWwindow* window, glm::vec2 cursor) {
+    if (glfwGetInputMode(window, GLFW_CURSOR) == GLFW_CURSOR_DISABLED) return glm::vec2(0.f);
+    // cursor positions are in window coordinates, which differ from pixels on high dpi screens
+    int width = 0, height = 0;
+    glfwGetWindowSize(window, &width, &height);
+    if (width <= 0 || height <= 0) return glm::vec2(0.f);
+    return glm::vec2(2.f * cursor.x / width - 1.f, 1.f - 2.f * cursor.y / height);
+}
+
+// ndc is the picked point in normalized device coordinates
+void pick_object(glm::vec2 ndc) {
+    auto hit = pick(scene_bvh, pick_ray(ndc, camera_view(), camera_projection()), 100.f, pick_packet_budget,
+            [](uint32_t) { return &pyramid_triangles; },
+            [](uint32_t object) { return object_model_matrix(cube_positions[object]); });
+    if (!verbose) return;
+    if (hit.object == bvh_empty_slot) LOG_INFO("Picked nothing");
+    else LOG_INFO("Picked object {%u} triangle {%u} at {%f, %f, %f}", hit.object, hit.triangle,
+            hit.point.x, hit.point.y, hit.point.z);
 }
 
 void process_scroll_input(GLFWwindow* window, double x, double y) {
     state.fov -= (float)y;
     state.fov = glm::clamp(state.fov, 1.f, 100.f);
-    if (verbose) printf("New FOV: {%f}\n" , state.fov);
+    if (verbose) LOG_INFO("New FOV: {%f}", state.fov);
 }
 
-void process_input(GLFWwindow* window, input_frame* last_frame) {
-    auto new_frame = *last_frame;
-    
-    new_frame.space = glfwGetKey(window, GLFW_KEY_SPACE);
-    new_frame.p = glfwGetKey(window, GLFW_KEY_P);
-    new_frame.w = glfwGetKey(window, GLFW_KEY_W);
-    new_frame.a = glfwGetKey(window, GLFW_KEY_A);
-    new_frame.s = glfwGetKey(window, GLFW_KEY_S);
-    new_frame.d = glfwGetKey(window, GLFW_KEY_D);
-    new_frame.q = glfwGetKey(window, GLFW_KEY_Q);
-    new_frame.e = glfwGetKey(window, GLFW_KEY_E);
-
-    new_frame.r_mouse =  glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT);
-    new_frame.l_mouse =  glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT);
-
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) { 
+// callbacks only record what happened; glfw runs them inside glfwPollEvents
+void push_key_input(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    input_events.push({ glfwGetTime(), input_event::key, key, action, glm::dvec2(0.0) });
+}
+
+void push_mouse_button_input(GLFWwindow* window, int button, int action, int mods) {
+    input_events.push({ glfwGetTime(), input_event::key, input_mouse_button(button), action, glm::dvec2(0.0) });
+}
+
+void push_mouse_input(GLFWwindow* window, double x, double y) {
+    input_events.push({ glfwGetTime(), input_event::cursor, 0, 0, glm::dvec2(x, y) });
+}
+
+void push_scroll_input(GLFWwindow* window, double x, double y) {
+    input_events.push({ glfwGetTime(), input_event::scroll, 0, 0, glm::dvec2(x, y) });
+}
+
+// applies everything queued since the last frame, in the order it happened;
+// per cursor event this only sums the motion and notes the looking position
+void drain_input(GLFWwindow* window, input_frame* frame) {
+    input.begin_frame();
+    frame->looked = false;
+    input_event event;
+    while (input_events.pop(event)) {
+        input.apply(event);
+        if (event.type == input_event::cursor && input.down(input_bindings[bind_look])) {
+            frame->look_xy = scaled_cursor(event.xy);
+            frame->looked = true;
+        }
+    }
+    frame->scroll = (float)input.scroll.y;
+}
+
+// this frame's live input; last_frame carries the look position over
+void read_input(GLFWwindow* window, const input_frame* last_frame, input_frame* frame) {
+    *frame = *last_frame;
+    drain_input(window, frame);
+    frame->cursor = glm::vec2(input.cursor.x, input.cursor.y);
+
+    frame->down = frame->pressed = 0;
+    for (int i = 0; i < binding_count; i++) {
+        if (input.down(input_bindings[i])) frame->down |= 1u << i;
+        if (input.pressed(input_bindings[i])) frame->pressed |= 1u << i;
+    }
+}
+
+// everything a frame's input does, whether it is live or replayed
+void process_input(GLFWwindow* window, const input_frame* frame) {
+    auto& new_frame = *frame;
+    if (new_frame.tapped(bind_quit)) {
         glfwSetWindowShouldClose(window, true);
-    } 
+    }
 
-    if (new_frame.space == GLFW_PRESS && 
-            last_frame->space == GLFW_RELEASE) {
+    process_mouse_input(window, frame);
+    if (new_frame.scroll != 0.f) process_scroll_input(window, 0.0, new_frame.scroll);
+
+    if (new_frame.tapped(bind_wireframe)) {
         state.wireframe = !state.wireframe;
         int key = state.wireframe ? GL_LINE : GL_FILL;
         glPolygonMode(GL_FRONT_AND_BACK, key);
         verbose_toggle("Wireframe", state.wireframe);
     }
 
-    if (new_frame.p == GLFW_PRESS &&
-            last_frame->p == GLFW_RELEASE) {
+    if (new_frame.tapped(bind_perspective)) {
         state.perspective = !state.perspective;
         // effect happens next frame in render_loop
         verbose_toggle("Perspective", state.perspective);
     }
 
-    if (new_frame.w == GLFW_PRESS) {
+    if (new_frame.tapped(bind_pick)) {
+        pick_object(pick_ndc(window, new_frame.cursor));
+    }
+
+    if (new_frame.tapped(bind_occlusion)) {
+        state.occlusion_culling = !state.occlusion_culling;
+        verbose_toggle("Occlusion culling", state.occlusion_culling);
+    }
+
+    if (new_frame.tapped(bind_grid)) {
+        state.grid_culling = !state.grid_culling;
+        verbose_toggle("Grid culling", state.grid_culling);
+    }
+
+    if (new_frame.tapped(bind_overlay)) {
+        state.overlay = !state.overlay;
+        verbose_toggle("Overlay", state.overlay);
+    }
+
+    if (new_frame.held(bind_forward)) {
         state.camera_position += position_delta_with_rotation(glm::vec3(0, 0, -1));
     }
-    if (new_frame.a == GLFW_PRESS) {
+    if (new_frame.held(bind_left)) {
         state.camera_position += position_delta_with_rotation(glm::vec3(-1, 0, 0));
     }
-    if (new_frame.s == GLFW_PRESS) {
+    if (new_frame.held(bind_back)) {
         state.camera_position += position_delta_with_rotation(glm::vec3(0, 0, 1));
     }
-    if (new_frame.d == GLFW_PRESS) {
+    if (new_frame.held(bind_right)) {
         state.camera_position += position_delta_with_rotation(glm::vec3(1, 0, 0));
     }
-    if (new_frame.q == GLFW_PRESS) {
+    if (new_frame.held(bind_down)) {
         state.camera_position += position_delta_with_rotation(glm::vec3(0, -1, 0));
     }
-    if (new_frame.e == GLFW_PRESS) {
+    if (new_frame.held(bind_up)) {
         state.camera_position += position_delta_with_rotation(glm::vec3(0, 1, 0));
     }
-    *last_frame = new_frame; 
+}
+
+// steps the clock and picks the input the frame runs with; a replay swaps in
+// its recorded frame and timestep, a camera path places the camera itself
+// and leaves no input; false once either runs out or is cancelled
+bool next_frame(GLFWwindow* window, input_frame* frame) {
+    read_input(window, &state.last_input_frame, frame);
+    state.last_input_frame = *frame;
+
+    if (flythrough.loaded()) {
+        if (frame->tapped(bind_quit) || !flythrough.next(state.camera_position, state.camera_rotation)) return false;
+        *frame = input_frame {};
+        state.dT = flythrough.step;
+        state.frame_time += state.dT;
+    } else if (input_replay_path) {
+        if (frame->tapped(bind_quit) || !replay.next(state.dT, *frame)) return false;
+        state.frame_time += state.dT;
+    } else {
+        auto time = glfwGetTime();
+        state.dT = time - state.frame_time;
+        state.frame_time = time;
+    }
+    recorder.record(state.dT, *frame);
+    return true;
 }
 
 void update_color(Shader* shader, float time) {
@@ -234,45 +512,129 @@ void update_color(Shader* shader, float time) {
     auto g = (sin(time) / 2.f) + 0.5f;
     auto b = (sin(time / 2) / 2.f) + 0.5f;
     auto vert_location = glGetUniformLocation(shader->ID, "prog_color");
+    frame_stats.state_changes++;
     // glUniform4f(vert_location, r, g, b, 1.0f);
     glUniform4f(vert_location, 1.f, 1.f, 1.f, 1.0f);
 }
 
-void update_draw_transform(Shader* shader, float time) {
-    glm::vec3 cube_positions[] = {
-        glm::vec3( 0.0f,  0.0f,  0.0f ), 
-        glm::vec3( 2.0f,  5.0f, -15.0f ), 
-        glm::vec3(-1.5f, -2.2f, -2.5f),  
-        glm::vec3(-3.8f, -2.0f, -12.3f),  
-        glm::vec3( 2.4f, -0.4f, -3.5f ),  
-        glm::vec3(-1.7f,  3.0f, -7.5f),  
-        glm::vec3( 1.3f, -2.0f, -2.5f ),  
-        glm::vec3( 1.5f,  2.0f, -2.5f ), 
-        glm::vec3( 1.5f,  0.2f, -1.5f ), 
-        glm::vec3(-1.3f,  1.0f, -1.5f)  
-    };
+// screen pixels covered by one world unit at the given distance from the camera
+float pixels_per_unit(float distance) {
+    if (!state.perspective) {
+        auto ortho_fov = state.fov / 45.f / 2.f;
+        return state.height / (2.f * ortho_fov);
+    }
+    distance = glm::max(distance, 0.1f);
+    return state.height / (2.f * tan(glm::radians(state.fov) / 2.f) * distance);
+}
+
+// asks for the mips a material needs on an object drawn at this scale
+void touch_material(const material& m, float uv_density, float pixels) {
+    for (auto id : { m.diffuse, m.overlay }) {
+        auto texels = glm::max(textures.texel_size(id).x, textures.texel_size(id).y) * uv_density;
+        residency.touch(textures.get(id).array, texture_mip_level(texels, pixels));
+    }
+}
 
+glm::mat4 camera_view() {
     glm::mat4 view = glm::mat4(1.0f);
     view = glm::mat4_cast(state.camera_rotation) * view;
     view = glm::translate(view, -state.camera_position); 
+    return view;
+}
 
-    shader->setmat4("view", view);
-
-    glm::mat4 projection;
+glm::mat4 camera_projection() {
     auto ortho_fov = state.fov / 45.f / 2.f;
-    projection = state.perspective 
+    return state.perspective 
         ? glm::perspective(glm::radians(state.fov), 1.f, 0.1f, 100.f)
         : glm::ortho(-ortho_fov, ortho_fov, -ortho_fov, ortho_fov, 0.1f, 100.f); 
+}
+
+// occluders are the designated objects that look biggest this frame; small
+// and distant ones hide little and would only cost triangle setup
+const unsigned int max_occluders = 32;
+const float min_occluder_size = 0.02f; // bounding sphere radius over distance
+
+struct occluder_candidate {
+    uint32_t object;
+    float size; // projected, as radius over distance
+};
+
+// picks from visible_objects, so call after the frustum query
+void rasterize_occluders(const glm::mat4& view_projection) {
+    occlusion.begin_frame(view_projection);
+    frame_vector<occluder_candidate> candidates { frame_allocator<occluder_candidate>(&frame_memory) };
+    candidates.reserve(visible_objects.size());
+    for (auto i : visible_objects) {
+        if (!cube_occluders[i]) continue;
+        auto distance = glm::length(cube_positions[i] + pyramid_center - state.camera_position);
+        auto size = pyramid_radius / std::max(distance, 0.1f);
+        if (size >= min_occluder_size) candidates.push_back(occluder_candidate { i, size });
+    }
+    auto count = std::min<size_t>(candidates.size(), max_occluders);
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(),
+            [](const occluder_candidate& a, const occluder_candidate& b) { return a.size > b.size; });
+    for (size_t k = 0; k < count; k++) {
+        auto model = object_model_matrix(cube_positions[candidates[k].object]);
+        occlusion.add_occluder(pyramid_mesh, pyramid_mesh.indices.data(),
+                pyramid_mesh.indices.size(), model);
+    }
+    occlusion.rasterize();
+}
+
+void update_draw_transform(Shader* shader, float time) {
+    glm::mat4 view = camera_view();
+    shader->setmat4("view", view);
+
+    glm::mat4 projection = camera_projection();
     shader->setmat4("projection", projection);
+    frame_stats.state_changes += 2;
+
+    visible_objects.clear();
+    auto view_frustum = frustum_from_matrix(projection * view);
+    if (state.grid_culling) {
+        // dynamic objects report their new position every frame, O(1) each
+        for (auto i = 0; i < cube_count; i++) {
+            scene_grid.move(i, cube_positions[i] + pyramid_bounds.center());
+        }
+        scene_grid.query_frustum(view_frustum, visible_objects);
+    } else {
+        scene_bvh.query_frustum(view_frustum, visible_objects);
+    }
+    frame_stats.visible = visible_objects.size();
+
+    if (state.occlusion_culling) rasterize_occluders(projection * view);
     
-    auto len = sizeof(cube_positions)/sizeof(cube_positions[0]);
-    for(auto i = 0; i < len; i++) {
-        glm::mat4 model = glm::mat4(1.f);
-        model = glm::translate(model, cube_positions[i]); 
+    frame_vector<draw_item> draws { frame_allocator<draw_item>(&frame_memory) };
+    draws.reserve(visible_objects.size());
+    for(auto i : visible_objects) {
+        if (state.occlusion_culling &&
+                !occlusion.test_aabb(aabb_translate(pyramid_bounds, cube_positions[i]))) {
+            continue;
+        }
+        auto distance = glm::length(cube_positions[i] + pyramid_center - state.camera_position) - pyramid_radius;
+        draws.push_back(draw_item { i, distance });
+    }
+    std::sort(draws.begin(), draws.end(), [](const draw_item& a, const draw_item& b) {
+        return a.distance < b.distance;
+    });
+
+    for (const auto& draw : draws) {
+        auto i = draw.object;
+        auto distance = draw.distance;
+        glm::mat4 model = object_model_matrix(cube_positions[i]);
         // model = glm::rotate(model, 6 * sin(time * (i+1) /6) + i / 6.f, glm::vec3(0.5f, 1.f, 0.f));
         shader->setmat4("model", model);
+
+        cube_lods[i] = select_lod(pyramid_lods, pixels_per_unit(distance), cube_lods[i],
+                state.lod_error_pixels, state.lod_hysteresis);
+        auto lod = pyramid_lods.levels[cube_lods[i]];
+        if (!state.bindless) touch_material(pyramid_material, pyramid_uv_density, pixels_per_unit(distance));
         
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, lod.index_count, GL_UNSIGNED_INT,
+                (void*)(lod.index_offset * sizeof(unsigned int)));
+        frame_stats.state_changes++;
+        frame_stats.draw_calls++;
+        frame_stats.triangles += lod.index_count / 3;
     }
 }
 
@@ -288,100 +650,226 @@ void update(Shader* shader, float time) {
     update_draw_transform(shader, time);
 }
 
-void render(GLFWwindow* window, Shader* shader, GLuint vao) {
+// array units match textures.bind(0), so switching materials is uniforms only
+void set_material_texture(Shader* shader, const std::string& name, unsigned int id) {
+    if (state.bindless) {
+        shader->seti(name, id);
+        frame_stats.state_changes++;
+        return;
+    }
+    auto& layer = textures.get(id);
+    frame_stats.state_changes += 3;
+    shader->seti(name, layer.array);
+    shader->setf(name + "_layer", (float)layer.layer);
+    shader->setvec4(name + "_rect", layer.uv_rect);
+}
+
+void set_material(Shader* shader, const material& m) {
+    set_material_texture(shader, "tex", m.diffuse);
+    set_material_texture(shader, "tex2", m.overlay);
+}
+
+// points the Shader at the program behind its handle, which changes when
+// the sources are edited; per-program state has to be set again then
+void sync_program(Shader* shader) {
+    auto program = resources.get(shader_program);
+    if (!program || program->name == shader->ID) return;
+    shader->ID = program->name;
+    if (state.bindless) shader->set_block_binding("bindless_textures", 0);
+    if (verbose) LOG_INFO("Using shader {%d}", shader->ID);
+}
+
+// Frame and CPU/GPU times with their last couple of seconds as graphs, what
+// the frame submitted, GPU memory and culling, as text and bars in one draw.
+// cpu_ms is the frame's CPU time up to here; the GPU time is a few frames old.
+void draw_overlay(double cpu_ms) {
+    auto start = glfwGetTime();
+    auto gpu_ms = overlay_gpu_timer.milliseconds.empty() ? overlay_timings.last_gpu_ms()
+            : overlay_gpu_timer.milliseconds.back();
+    overlay_gpu_timer.milliseconds.clear();
+    overlay_timings.push(1000.f * state.dT, cpu_ms, gpu_ms);
+
+    size_t texture_bytes = 0;
+    for (unsigned int a = 0; a < textures.get_arrays().size(); a++) texture_bytes += textures.resident_bytes(a);
+
+    const auto white = overlay_color(255, 255, 255), green = overlay_color(96, 224, 96);
+    const auto orange = overlay_color(240, 160, 48), shade = overlay_color(0, 0, 0, 160);
+    const float x = 8.f, graph_height = 40.f, graph_scale = 33.3f; // ms at the top of a graph
+    auto line = overlay.line_height();
+    auto y = 8.f;
+    overlay.begin();
+    overlay.rect(x - 4.f, y - 4.f, 3.f * overlay_history::size + 8.f, 11.f * line + 2.f * graph_height + 16.f, shade);
+    overlay.text(x, y, white, "frame %6.2f ms %5.0f fps", 1000.f * state.dT, state.dT > 0.f ? 1.f / state.dT : 0.f);
+    overlay.text(x, y += line, green, "cpu %6.2f ms", cpu_ms);
+    overlay.text(x + 120.f, y, orange, "gpu %6.2f ms", gpu_ms);
+    y += line;
+    overlay.graph(x, y, 3.f * overlay_history::size, graph_height, overlay_timings.cpu_ms, overlay_history::size,
+            overlay_timings.next, graph_scale, green);
+    y += graph_height + 4.f;
+    overlay.graph(x, y, 3.f * overlay_history::size, graph_height, overlay_timings.gpu_ms, overlay_history::size,
+            overlay_timings.next, graph_scale, orange);
+    y += graph_height + 4.f;
+    overlay.text(x, y, white, "draws %u  state %u", frame_stats.draw_calls, frame_stats.state_changes);
+    overlay.text(x, y += line, white, "tris %llu", (unsigned long long)frame_stats.triangles);
+    overlay.text(x, y += line, white, "objects %d  frustum %u  occluded %u", cube_count, frame_stats.visible,
+            frame_stats.visible - frame_stats.draw_calls);
+    overlay.text(x, y += line, white, "tex %.1f MB  buf %.2f MB", texture_bytes / 1048576.0,
+            resources.buffer_bytes() / 1048576.0);
+    overlay.text(x, y += line, white, "overlay %.3f ms  worst %.3f ms", overlay_ms, overlay_worst_ms);
+    // how many cursor reports a frame folds together, over what span, and how
+    // old the newest is by the time the frame is drawn; replays show no live input
+    if (input.cursor_events) {
+        overlay.text(x, y += line, white, "mouse %u in %.1f ms  %+.0f %+.0f  age %.1f ms", input.cursor_events,
+                1000.0 * (input.cursor_last_time - input.cursor_first_time), input.cursor_delta.x, input.cursor_delta.y,
+                1000.0 * (start - input.cursor_last_time));
+    } else {
+        overlay.text(x, y += line, white, "mouse idle");
+    }
+    // samples and shader invocations per pixel are overdraw; vertex shader runs
+    // per triangle show how well the post-transform cache reuses vertices
+    auto pixels = glm::max(state.width * state.height, 1.f);
+    if (auto scene = gpu_queries.find("scene")) {
+        auto end = overlay.text(x, y += line, white, "overdraw %.2f", scene->counters[gpu_samples_passed] / pixels);
+        if (scene->has(gpu_fragment_invocations)) {
+            overlay.text(end, y, white, "  fs/px %.2f", scene->counters[gpu_fragment_invocations] / pixels);
+        }
+        if (scene->has(gpu_vertex_invocations)) {
+            overlay.text(x, y += line, white, "vs/tri %.2f  clip %llu>%llu",
+                    scene->counters[gpu_vertex_invocations] / std::max((double)scene->counters[gpu_primitives_generated], 1.0),
+                    (unsigned long long)scene->counters[gpu_clipping_input],
+                    (unsigned long long)scene->counters[gpu_clipping_output]);
+        } else {
+            overlay.text(x, y += line, white, "prims %llu  pipeline stats n/a",
+                    (unsigned long long)scene->counters[gpu_primitives_generated]);
+        }
+    }
+
+    if (state.wireframe) glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    auto program = resources.get(overlay_program);
+    gpu_queries.begin_pass("overlay");
+    overlay.draw(program ? program->name : 0, state.width, state.height, overlay_texture_unit, samplers);
+    gpu_queries.end_pass();
+    if (state.wireframe) glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+
+    overlay_ms = 1000.0 * (glfwGetTime() - start);
+    overlay_worst_ms = std::max(overlay_worst_ms, overlay_ms);
+}
+
+void render(GLFWwindow* window, Shader* shader) {
+    auto cpu_start = glfwGetTime();
+    if (state.overlay) {
+        overlay_gpu_timer.begin_frame();
+        gpu_queries.begin_frame();
+    }
+    heap_tracker.begin_frame();
+    frame_memory.begin_frame();
+    frame_stats = render_stats {};
     glClearColor(1.0, 0.0, 1.0, 1.0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glBindVertexArray(vao);
+    if (glfwGetTime() - last_program_check > 0.5) {
+        last_program_check = glfwGetTime();
+        if (resources.reload_changed_programs()) sync_program(shader);
+    }
+    glBindVertexArray(resources.get(pyramid_gpu)->vao);
     shader->use();
-    shader->seti("tex", 0);
-    shader->seti("tex2", 1);
+    if (state.bindless) bindless.bind(0);
+    else textures.bind(0, samplers);
+    // program, vao, then a texture and a sampler per array or the one handle block
+    frame_stats.state_changes += 2 + (state.bindless ? 1 : 2 * textures.get_arrays().size());
+    set_material(shader, pyramid_material);
     
-    auto time = glfwGetTime();
-    state.dT = time - state.last_frame_time;
-    update(shader, time); 
-    state.last_frame_time = time;
+    gpu_queries.begin_pass("scene");
+    update(shader, state.frame_time); 
+    gpu_queries.end_pass();
+    // after drawing, so this frame's touches decide what streams next
+    if (!state.bindless) residency.update(textures, &workers);
+    if (state.overlay) {
+        overlay_gpu_timer.end_frame();
+        draw_overlay(1000.0 * (glfwGetTime() - cpu_start));
+        gpu_queries.end_frame();
+    }
+    resources.end_frame();
+    heap_tracker.end_frame();
     
     glfwSwapBuffers(window);
+#ifdef LEARNOPENGL_GL_TRACE
+    gl_trace_end_frame();
+#endif
 }
 
-void load_texture(const char* path, GLenum image_format, GLenum active_texture) {
-    // texture wrapping config
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRROR_CLAMP_TO_EDGE); 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRROR_CLAMP_TO_EDGE);
-
-    // filtering mode
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // same but mipmaps
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    // magnification wouldn't need (can't) mipmap interpolation
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    int width, height, number_of_color_channels;
+// everything derived from cube_positions; needs the pyramid from render_init
+void build_scene() {
+    cube_count = (int)cube_positions.size();
+    cube_lods.assign(cube_count, 0);
+    // pyramids are closed and opaque, so any of them can hide the others;
+    // rasterize_occluders picks the ones worth it each frame
+    cube_occluders.assign(cube_count, true);
+
+    std::vector<aabb> object_bounds(cube_count);
+    for (auto i = 0; i < cube_count; i++) {
+        object_bounds[i] = aabb_translate(pyramid_bounds, cube_positions[i]);
+    }
+    scene_bvh.build(object_bounds, &workers);
 
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* data = stbi_load(path, &width, &height, &number_of_color_channels, 0);
+    scene_grid = loose_grid(4.f);
+    auto extent = pyramid_bounds.extent();
+    auto half_extent = glm::max(extent.x, glm::max(extent.y, extent.z));
+    for (auto i = 0; i < cube_count; i++) {
+        scene_grid.insert(i, cube_positions[i] + pyramid_bounds.center(), half_extent);
+    }
+}
 
-    assrt(data, "Failed to load texture {%s}", path);
+void render_init(GLFWwindow* window, Shader* shader) {
+    pyramid_mesh = make_pyramid_mesh();
+    pyramid_lods = build_lod_chain(pyramid_mesh);
+    pyramid_bounds = mesh_aabb(pyramid_mesh);
+    mesh_bounding_sphere(pyramid_mesh, pyramid_center, pyramid_radius);
+    pyramid_uv_density = mesh_uv_density(pyramid_mesh);
+    pack_mesh(pyramid_mesh, pyramid_triangles, &workers);
+    build_scene();
+    if (verbose) {
+        for (size_t i = 0; i < pyramid_lods.levels.size(); i++) {
+            auto level = pyramid_lods.levels[i];
+            printf("LOD %zu: {%u} triangles, error {%f}\n", i, level.index_count / 3, level.error);
+        }
+    }
 
-    unsigned int texture;
-    glGenTextures(1, &texture);
-    glActiveTexture(active_texture); 
-    glBindTexture(GL_TEXTURE_2D, texture);
+    // the face is a cutout, keep its silhouette from thinning out in the smaller mips
+    mip_options cutout;
+    cutout.alpha_cutoff = 0.5f;
+    textures.set_files(&assets);
+    pyramid_material.diffuse = textures.add(image_path);
+    pyramid_material.overlay = textures.add(image2_path, cutout);
+    // bindless handles freeze storage, so streaming needs to know first
+    state.bindless = bindless_textures::supported();
+    textures.upload(&workers, state.texture_streaming && !state.bindless);
+    if (state.bindless) bindless.build(textures, samplers);
+    if (verbose) {
+        for (const auto& info : textures.get_arrays()) {
+            printf("Texture array {%d}x{%d} with {%u} layers\n", info.width, info.height, info.layer_count);
+        }
+        auto& load = textures.stats;
+        printf("Textures loaded in {%f} ms: {%zu} file bytes, {%zu} decoded, {%zu} copied, {%zu} staged, peak rss {%zu} KB\n",
+                load.milliseconds, load.file_bytes, load.decoded_bytes, load.copied_bytes, load.staged_bytes,
+                load.peak_rss / 1024);
+        printf("Bindless textures {%s}\n", state.bindless ? "on" : "off");
+        printf("Texture streaming {%s}, uv density {%f}\n",
+                state.texture_streaming && !state.bindless ? "on" : "off", pyramid_uv_density);
+    }
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, image_format, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    // every lod indexes the same vertices, so one vao draws all of them
+    pyramid_gpu = resources.create_mesh(pyramid_mesh.vertices, pyramid_lods.indices, resource_key("pyramid"));
 
-    
-    stbi_image_free(data);
-}
-
-void render_init(GLFWwindow* window, Shader* shader, GLuint &vao) {
-    float vertices[] = {
-        // positions          //colors          // texture coordinates
-        -0.5f, -0.5f, 0.0f,   1.f, 0.f, 0.f,    0.f, 0.f,      
-         0.5f, -0.5f, 0.0f,   0.f, 1.f, 0.f,    1.f, 0.f,
-        -0.5f,  0.5f, 0.0f,   0.f, 0.f, 1.f,    0.f, 1.f,
-         0.5f,  0.5f, 0.0f,   1.f, 1.f, 1.f,    1.f, 1.f,
-         0.0f,  0.0f, 0.5f,   0.f, 0.f, 0.f,    2.f, 2.f, 
-    };
-    unsigned int indices[] = {
-        0, 3, 2,
-        1, 3, 0,
-        0, 1, 4,
-        0, 2, 4,
-        2, 4, 3,
-        1, 3, 4
-    };
-
-    load_texture(image_path, GL_RGB, GL_TEXTURE0);
-    load_texture(image2_path, GL_RGBA, GL_TEXTURE1);
-
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-
-    unsigned int ebo; // element buffer object
-    glGenBuffers(1, &ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    unsigned int vbo; // vertex buffer object
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-   
-    shader->configure(vert_path, frag_path);
-    if (verbose) printf("Using shader {%d}\n", shader->ID);
-   
-    // intepret the vertex data (per vertex attribute)
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
+    resources.set_files(&assets);
+    shader_program = resources.load_program(vert_path, frag_path, state.bindless ? bindless_shader_header : nullptr);
+    assrt(resources.get(shader_program), "Failed to build shader program.");
+    shader->ID = 0;
+    sync_program(shader);
+    overlay_program = resources.load_program(overlay_vert_path, overlay_frag_path);
+    overlay.init();
+    gpu_queries.init();
+    if (verbose) printf("Pipeline statistics queries {%s}\n", gpu_queries.pipeline_statistics ? "on" : "off");
 
     glEnable(GL_DEPTH_TEST);
 
@@ -392,26 +880,194 @@ void render_init(GLFWwindow* window, Shader* shader, GLuint &vao) {
     }
 }
 
-int main() {
-    // init window
+GLFWwindow* create_window(bool visible) {
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
     GLFWwindow* window = glfwCreateWindow(state.width, state.height, "LearnOpenGL", NULL, NULL);
     assrt(window != NULL, "Failed to create GLFW window");
 
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);  
-    
     glfwMakeContextCurrent(window);
     assrt(gladLoadGLLoader((GLADloadproc)glfwGetProcAddress), "Failed to initialize GLAD");
+#ifdef LEARNOPENGL_GL_TRACE
+    gl_trace_install();
+#endif
 
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    return window;
+}
+
+#ifdef LEARNOPENGL_BENCH
+// LearnOpenGL_bench renders generated scenes of textured pyramids in every
+// draw path with the window hidden, and writes frame statistics as JSON:
+//
+//   LearnOpenGL_bench [--frames N] [--scenes 1000,10000] [--out bench.json]
+//   LearnOpenGL_bench --compare baseline.json current.json [--threshold 0.1]
+//
+// Comparing exits with 1 when any timing regressed by more than the threshold.
+
+struct bench_path {
+    const char* name;
+    bool grid_culling;
+    bool occlusion_culling;
+};
+
+const bench_path bench_paths[] = {
+    { "bvh", false, false },
+    { "grid", true, false },
+    { "bvh_occlusion", false, true },
+};
+
+// count pyramids at a constant density in a cube around the origin; the seed
+// is fixed so every run draws the same scene
+void generate_scene(unsigned int count) {
+    std::mt19937 random(1234);
+    auto side = 3.f * std::cbrt((float)count);
+    std::uniform_real_distribution<float> coordinate(-side / 2.f, side / 2.f);
+    cube_positions.resize(count);
+    for (auto& position : cube_positions) {
+        position = glm::vec3(coordinate(random), coordinate(random), coordinate(random));
+    }
+    build_scene();
+}
+
+bench_result run_benchmark(GLFWwindow* window, Shader* shader, const bench_path& path, unsigned int frames) {
+    const unsigned int warmup = 5;
+    state.grid_culling = path.grid_culling;
+    state.occlusion_culling = path.occlusion_culling;
+    state.camera_position = glm::vec3(0.f);
+
+    bench_result result;
+    result.path = path.name;
+    result.objects = cube_count;
+    result.frames = frames;
+    std::vector<double> cpu_ms;
+    gpu_frame_timer gpu;
+    for (unsigned int frame = 0; frame < warmup + frames; frame++) {
+        if (frame == warmup) {
+            cpu_ms.clear();
+            gpu.reset();
+        }
+        // one full turn over the run, so the whole scene gets drawn
+        state.camera_rotation = camera_look_rotation(-90.0 + 360.0 * frame / (warmup + frames), 0.0);
+        state.dT = 1.f / 60.f;
+        state.frame_time += state.dT;
+
+        auto start = glfwGetTime();
+        gpu.begin_frame();
+        render(window, shader);
+        gpu.end_frame();
+        glfwPollEvents();
+        if (frame < warmup) continue;
+        cpu_ms.push_back(1000.0 * (glfwGetTime() - start));
+        result.draw_calls += frame_stats.draw_calls;
+        result.state_changes += frame_stats.state_changes;
+        result.triangles += frame_stats.triangles;
+    }
+    gpu.finish();
+    result.cpu_ms_mean = mean(cpu_ms);
+    result.cpu_ms_p50 = percentile(cpu_ms, 50.0);
+    result.cpu_ms_p95 = percentile(cpu_ms, 95.0);
+    result.cpu_ms_p99 = percentile(cpu_ms, 99.0);
+    result.gpu_ms_mean = mean(gpu.milliseconds);
+    result.draw_calls /= frames;
+    result.state_changes /= frames;
+    result.triangles /= frames;
+    gpu.release();
+    return result;
+}
+
+int run_benchmarks(int argc, char** argv) {
+    unsigned int frames = 100;
+    std::vector<unsigned int> scenes = { 1000, 10000, 100000, 1000000 };
+    const char* report_path = "bench.json";
+    const char* compare_paths[2] = { nullptr, nullptr };
+    double threshold = 0.1;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--frames") && i + 1 < argc) frames = glm::max(atoi(argv[++i]), 1);
+        else if (!strcmp(argv[i], "--out") && i + 1 < argc) report_path = argv[++i];
+        else if (!strcmp(argv[i], "--threshold") && i + 1 < argc) threshold = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--compare") && i + 2 < argc) {
+            compare_paths[0] = argv[++i];
+            compare_paths[1] = argv[++i];
+        } else if (!strcmp(argv[i], "--scenes") && i + 1 < argc) {
+            scenes.clear();
+            for (char* list = argv[++i]; *list; list += *list == ',') {
+                scenes.push_back(strtoul(list, &list, 10));
+                if (*list && *list != ',') break;
+            }
+        }
+    }
+
+    if (compare_paths[0]) {
+        auto regressions = compare_bench_reports(read_bench_report(compare_paths[0]),
+                read_bench_report(compare_paths[1]), threshold);
+        printf("{%u} regressions over {%.1f%%}\n", regressions, 100.0 * threshold);
+        return regressions ? 1 : 0;
+    }
+
+    auto window = create_window(false);
+    glfwSwapInterval(0); // frame times, not the display rate
+    assets.mount(archive_path);
+    Shader shader;
+    render_init(window, &shader);
+
+    std::vector<bench_result> results;
+    for (auto count : scenes) {
+        generate_scene(count);
+        for (const auto& path : bench_paths) {
+            auto result = run_benchmark(window, &shader, path, frames);
+            printf("%-14s %8u objects: cpu p50 {%.3f} p95 {%.3f} p99 {%.3f} ms, gpu {%.3f} ms, "
+                    "{%.0f} draws, {%.0f} state changes, {%.0f} triangles\n", result.path.c_str(), result.objects,
+                    result.cpu_ms_p50, result.cpu_ms_p95, result.cpu_ms_p99, result.gpu_ms_mean,
+                    result.draw_calls, result.state_changes, result.triangles);
+            results.push_back(result);
+        }
+    }
+    auto written = write_bench_report(report_path, results);
+    if (written) printf("Wrote {%zu} results to {%s}\n", results.size(), report_path);
+#ifdef LEARNOPENGL_GL_TRACE
+    gl_trace_print_summary();
+#endif
+
+    gpu_queries.release();
+    overlay.release();
+    bindless.release();
+    textures.release();
+    samplers.release();
+    resources.release_all();
+    glfwTerminate();
+    return written ? 0 : 1;
+}
+#endif
+
+int main(int argc, char** argv) {
+#ifdef LEARNOPENGL_BENCH
+    return run_benchmarks(argc, argv);
+#endif
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--raw-mouse")) state.raw_mouse = true;
+        else if (i + 1 == argc) break;
+        else if (!strcmp(argv[i], "--record")) input_record_path = argv[++i];
+        else if (!strcmp(argv[i], "--replay")) input_replay_path = argv[++i];
+        else if (!strcmp(argv[i], "--path")) camera_path_file = argv[++i];
+        else if (!strcmp(argv[i], "--gl-trace")) gl_trace_path = argv[++i];
+    }
 
-    glfwSetCursorPosCallback(window, process_mouse_input);
-    glfwSetScrollCallback(window, process_scroll_input);
+    auto window = create_window(true);
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);  
+    if (state.raw_mouse && glfwRawMouseMotionSupported()) {
+        glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
+    }
+
+    glfwSetKeyCallback(window, push_key_input);
+    glfwSetMouseButtonCallback(window, push_mouse_button_input);
+    glfwSetCursorPosCallback(window, push_mouse_input);
+    glfwSetScrollCallback(window, push_scroll_input);
 
     if (GLAD_GL_KHR_debug) {
         glDebugMessageCallback(gl_debug_messenger, nullptr);
@@ -419,19 +1075,78 @@ int main() {
         glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
     }
 
+    auto mounted = assets.mount(archive_path);
+    if (verbose) {
+        printf("Asset archive {%s}: {%s}, {%u} entries\n", archive_path, mounted ? "mounted" : "missing",
+                assets.get_archive().size());
+    }
+
     Shader shader;
-    unsigned int vao;
-    render_init(window, &shader, vao);
+    render_init(window, &shader);
+
+    if (input_record_path) recorder.open(input_record_path);
+    if (input_replay_path && !replay.open(input_replay_path)) input_replay_path = nullptr;
+    if (camera_path_file && flythrough.parse(assets.read_text(camera_path_file), camera_path_file)) {
+        glfwSwapInterval(0); // frame times, not the display rate
+        if (verbose) printf("Camera path {%s}: {%f} seconds\n", camera_path_file, flythrough.duration());
+    }
+#ifdef LEARNOPENGL_GL_TRACE
+    if (gl_trace_path) gl_trace_open_histogram(gl_trace_path);
+#endif
 
     while (!glfwWindowShouldClose(window)) { // render loop
-        process_input(window, &state.last_input_frame);
-        render(window, &shader, vao);
+        input_frame frame;
+        if (!next_frame(window, &frame)) break;
+        auto frame_start = glfwGetTime();
+        process_input(window, &frame);
+        render(window, &shader);
+        flythrough.record(glfwGetTime() - frame_start);
         glfwPollEvents();
         auto error = glGetError();
         if (error) {
             //printf("%d\n", error);
         }
     }
+    log_flush(); // so the exit reports come after everything logged in the loop
+    recorder.close();
+    if (flythrough.loaded()) {
+        printf("Camera path {%s}:\n", camera_path_file);
+        flythrough.print_stats();
+    }
+    if (verbose && input_record_path) printf("Recorded {%llu} frames of input to {%s}\n",
+            (unsigned long long)recorder.size(), input_record_path);
+    if (verbose && input_replay_path) printf("Replayed {%zu} of {%zu} frames from {%s}\n",
+            replay.position(), replay.size(), input_replay_path);
+    if (verbose && overlay_worst_ms > 0.0) printf("Overlay worst frame {%f} ms\n", overlay_worst_ms);
+#ifdef LEARNOPENGL_GL_TRACE
+    if (verbose) gl_trace_print_summary();
+    gl_trace_close();
+#endif
+    if (verbose && gpu_queries.collected) {
+        printf("GPU query frames read {%llu}, skipped {%llu}\n", (unsigned long long)gpu_queries.collected,
+                (unsigned long long)gpu_queries.skipped);
+        for (const auto& pass : gpu_queries.results()) {
+            printf("  pass {%s}:", pass.name);
+            for (int c = 0; c < gpu_counter_count; c++) {
+                if (pass.has((gpu_counter)c)) printf(" %s {%llu}", gpu_counter_names[c], (unsigned long long)pass.counters[c]);
+            }
+            printf("\n");
+        }
+    }
+    gpu_queries.release();
+    overlay_gpu_timer.release();
+    overlay.release();
+    bindless.release();
+    textures.release();
+    samplers.release();
+    resources.release_all();
+    if (verbose) {
+        printf("Frames that touched the heap: {%llu} of {%llu}, frame arena high water {%zu} bytes\n",
+                (unsigned long long)heap_tracker.dirty_frames, (unsigned long long)heap_tracker.frames,
+                frame_memory.this_frame().high_water());
+        printf("Input events dropped on a full queue: {%u}\n", input_events.dropped.load());
+        printf("Log records dropped on a full ring: {%llu}\n", (unsigned long long)logger.dropped.load());
+    }
     glfwTerminate();
     return 0;
 }
@@ -0,0 +1,112 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file, so decoders can read it in place
+// instead of going through stdio buffers.
+class mapped_file {
+    private:
+        const unsigned char* bytes = nullptr;
+        size_t length = 0;
+
+        void unmap() {
+            if (!bytes) return;
+#ifdef _WIN32
+            UnmapViewOfFile(bytes);
+#else
+            munmap((void*)bytes, length);
+#endif
+            bytes = nullptr;
+            length = 0;
+        }
+
+    public:
+        mapped_file() {}
+        explicit mapped_file(const char* path) { open(path); }
+        ~mapped_file() { unmap(); }
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+        mapped_file(mapped_file&& other) noexcept
+            : bytes(std::exchange(other.bytes, nullptr)), length(std::exchange(other.length, 0)) {}
+        mapped_file& operator=(mapped_file&& other) noexcept {
+            if (this != &other) {
+                unmap();
+                bytes = std::exchange(other.bytes, nullptr);
+                length = std::exchange(other.length, 0);
+            }
+            return *this;
+        }
+
+        // false when the file is missing or empty
+        bool open(const char* path) {
+            unmap();
+#ifdef _WIN32
+            auto file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                    FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE) return false;
+            LARGE_INTEGER size;
+            if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+                auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (mapping) {
+                    bytes = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                    if (bytes) length = (size_t)size.QuadPart;
+                    CloseHandle(mapping);
+                }
+            }
+            CloseHandle(file);
+#else
+            auto fd = ::open(path, O_RDONLY);
+            if (fd < 0) return false;
+            struct stat info;
+            if (fstat(fd, &info) == 0 && info.st_size > 0) {
+                auto address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (address != MAP_FAILED) {
+                    bytes = (const unsigned char*)address;
+                    length = info.st_size;
+                    // decoders read front to back once
+                    madvise(address, length, MADV_SEQUENTIAL);
+                }
+            }
+            close(fd);
+#endif
+            return bytes != nullptr;
+        }
+
+        const unsigned char* data() const { return bytes; }
+        size_t size() const { return length; }
+};
+
+// high-water mark of the process's resident memory, in bytes
+inline size_t peak_rss_bytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+#endif
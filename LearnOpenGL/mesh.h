@@ -0,0 +1,101 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <cmath>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "bounds.h"
+
+// interleaved vertex data as uploaded to the vbo:
+// position (3), color (3), texture coordinates (2)
+const unsigned int mesh_vertex_stride = 8;
+
+struct mesh_data {
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+
+    unsigned int vertex_count() const {
+        return vertices.size() / mesh_vertex_stride;
+    }
+    unsigned int triangle_count() const {
+        return indices.size() / 3;
+    }
+    glm::vec3 position(unsigned int vertex) const {
+        auto v = &vertices[vertex * mesh_vertex_stride];
+        return glm::vec3(v[0], v[1], v[2]);
+    }
+    glm::vec2 uv(unsigned int vertex) const {
+        auto v = &vertices[vertex * mesh_vertex_stride];
+        return glm::vec2(v[6], v[7]);
+    }
+};
+
+inline mesh_data make_pyramid_mesh() {
+    mesh_data mesh;
+    mesh.vertices = {
+        // positions          //colors          // texture coordinates
+        -0.5f, -0.5f, 0.0f,   1.f, 0.f, 0.f,    0.f, 0.f,
+         0.5f, -0.5f, 0.0f,   0.f, 1.f, 0.f,    1.f, 0.f,
+        -0.5f,  0.5f, 0.0f,   0.f, 0.f, 1.f,    0.f, 1.f,
+         0.5f,  0.5f, 0.0f,   1.f, 1.f, 1.f,    1.f, 1.f,
+         0.0f,  0.0f, 0.5f,   0.f, 0.f, 0.f,    2.f, 2.f,
+    };
+    mesh.indices = {
+        0, 3, 2,
+        1, 3, 0,
+        0, 1, 4,
+        0, 2, 4,
+        2, 4, 3,
+        1, 3, 4
+    };
+    return mesh;
+}
+
+// model matrix of a mesh instance placed at position
+inline glm::mat4 object_model_matrix(glm::vec3 position) {
+    return glm::translate(glm::mat4(1.f), position);
+}
+
+inline aabb mesh_aabb(const mesh_data& mesh) {
+    aabb box { mesh.position(0), mesh.position(0) };
+    for (unsigned int i = 1; i < mesh.vertex_count(); i++) {
+        box.min = glm::min(box.min, mesh.position(i));
+        box.max = glm::max(box.max, mesh.position(i));
+    }
+    return box;
+}
+
+// bounding sphere around the vertex bounds center (not minimal, but cheap and stable)
+inline void mesh_bounding_sphere(const mesh_data& mesh, glm::vec3& center, float& radius) {
+    auto lo = glm::vec3(0.f);
+    auto hi = glm::vec3(0.f);
+    for (unsigned int i = 0; i < mesh.vertex_count(); i++) {
+        auto p = mesh.position(i);
+        lo = i ? glm::min(lo, p) : p;
+        hi = i ? glm::max(hi, p) : p;
+    }
+    center = 0.5f * (lo + hi);
+    radius = 0.f;
+    for (unsigned int i = 0; i < mesh.vertex_count(); i++) {
+        radius = glm::max(radius, glm::length(mesh.position(i) - center));
+    }
+}
+
+// uv units per world unit on the most densely mapped triangle, so a texture
+// of n texels spans n * density texels per world unit there
+inline float mesh_uv_density(const mesh_data& mesh) {
+    auto density = 0.f;
+    for (unsigned int t = 0; t < mesh.triangle_count(); t++) {
+        auto i0 = mesh.indices[t * 3], i1 = mesh.indices[t * 3 + 1], i2 = mesh.indices[t * 3 + 2];
+        auto world_area = glm::length(glm::cross(mesh.position(i1) - mesh.position(i0),
+                    mesh.position(i2) - mesh.position(i0)));
+        auto e1 = mesh.uv(i1) - mesh.uv(i0), e2 = mesh.uv(i2) - mesh.uv(i0);
+        auto uv_area = std::abs(e1.x * e2.y - e1.y * e2.x);
+        if (world_area > 1e-12f && uv_area > 0.f) density = glm::max(density, std::sqrt(uv_area / world_area));
+    }
+    return density;
+}
+
+#endif
@@ -0,0 +1,264 @@
+// CPU microbenchmarks for the per-frame math and scene kernels; no window
+// or GL context, so it runs on headless machines.
+//
+//   LearnOpenGL_microbench [filter] [--min-time seconds]
+//
+// Every kernel runs at several batch sizes, up to its own limit; the BVH
+// kernels go on to 1M objects. A run repeats the batch until it has taken at
+// least min-time, and the best of three runs is reported as time per item.
+// Kernels that stand for a whole frame's allocations bracket their work with
+// heap_tracker; if any call after the warm-up touches the heap, it's an error. The camera and transform kernels are the ones main.cpp
+// calls, from the GL-free camera_path.h and mesh.h.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+
+#define ALLOCATION_TRACKING_IMPLEMENTATION
+#include "allocators.h"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include "bounds.h"
+#include "bvh.h"
+#include "camera_path.h"
+#include "mesh.h"
+#include "occlusion.h"
+#include "spatial_grid.h"
+#include "thread_pool.h"
+
+// keeps the compiler from dropping work whose result is unused
+template <typename T>
+inline void keep(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+struct microbenchmark {
+    const char* name;
+    // sets up for a batch of this many items and returns the work to time
+    std::function<std::function<void()>(size_t batch)> setup;
+    size_t max_batch = 65536;
+};
+
+const size_t batch_sizes[] = { 16, 256, 4096, 65536, 1048576 };
+
+std::vector<glm::vec3> random_points(size_t count, float extent) {
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> coordinate(-extent, extent);
+    std::vector<glm::vec3> points(count);
+    for (auto& p : points) p = glm::vec3(coordinate(random), coordinate(random), coordinate(random));
+    return points;
+}
+
+// a scene like the benchmark renderer's: pyramids at constant density
+std::vector<glm::vec3> scene_positions(size_t count) {
+    return random_points(count, 1.5f * std::cbrt((float)count));
+}
+
+glm::mat4 scene_view_projection() {
+    auto view = glm::mat4_cast(camera_look_rotation(-90.0, 0.0));
+    return glm::perspective(glm::radians(45.f), 1.f, 0.1f, 100.f) * view;
+}
+
+struct draw_item {
+    uint32_t object;
+    float distance;
+};
+
+thread_pool workers;
+allocation_tracker heap_tracker;
+const mesh_data pyramid = make_pyramid_mesh();
+const aabb pyramid_bounds = mesh_aabb(pyramid);
+
+std::vector<aabb> scene_bounds(size_t count) {
+    auto positions = scene_positions(count);
+    std::vector<aabb> bounds(count);
+    for (size_t i = 0; i < count; i++) bounds[i] = aabb_translate(pyramid_bounds, positions[i]);
+    return bounds;
+}
+
+std::vector<microbenchmark> microbenchmarks() {
+    return {
+        { "camera_move", [](size_t batch) {
+            // position_delta_with_rotation
+            auto directions = random_points(batch, 1.f);
+            auto rotation = camera_look_rotation(30.0, 10.0);
+            return std::function<void()>([directions, rotation]() {
+                glm::vec3 sum(0.f);
+                for (const auto& d : directions) sum += camera_move_delta(d, rotation, 10.f, 1.f / 60.f);
+                keep(sum);
+            });
+        } },
+        { "camera_look", [](size_t batch) {
+            // the yaw/pitch to quaternion in process_mouse_input
+            auto angles = random_points(batch, 90.f);
+            return std::function<void()>([angles]() {
+                glm::quat sum(0.f, 0.f, 0.f, 0.f);
+                for (const auto& a : angles) sum = sum + camera_look_rotation(a.x, a.y);
+                keep(sum);
+            });
+        } },
+        { "model_matrix", [](size_t batch) {
+            // the per-draw translate in update_draw_transform, composed into a full mvp
+            auto positions = scene_positions(batch);
+            auto view_projection = scene_view_projection();
+            return std::function<void()>([positions, view_projection]() {
+                glm::vec4 sum(0.f);
+                for (const auto& p : positions) sum += (view_projection * object_model_matrix(p))[3];
+                keep(sum);
+            });
+        } },
+        { "bvh_build", [](size_t batch) {
+            auto bounds = scene_bounds(batch);
+            auto bvh = std::make_shared<bvh4>();
+            return std::function<void()>([bounds, bvh]() {
+                bvh->build(bounds, &workers);
+                keep(bvh->root_bounds());
+            });
+        }, 1048576 },
+        { "bvh_build_serial", [](size_t batch) {
+            auto bounds = scene_bounds(batch);
+            auto bvh = std::make_shared<bvh4>();
+            return std::function<void()>([bounds, bvh]() {
+                bvh->build(bounds);
+                keep(bvh->root_bounds());
+            });
+        }, 1048576 },
+        { "bvh_refit", [](size_t batch) {
+            // moves every object in place like the dynamic path, then refits
+            auto bvh = std::make_shared<bvh4>();
+            bvh->build(scene_bounds(batch), &workers);
+            auto step = std::make_shared<float>(0.01f);
+            return std::function<void()>([bvh, step]() {
+                *step = -*step;
+                auto offset = glm::vec3(*step, 0.f, 0.f);
+                for (auto& box : bvh->bounds) box = aabb_translate(box, offset);
+                bvh->refit(&workers);
+                keep(bvh->root_bounds());
+            });
+        }, 1048576 },
+        { "bvh_query", [](size_t batch) {
+            auto bvh = std::make_shared<bvh4>();
+            bvh->build(scene_bounds(batch), &workers);
+            auto view_frustum = frustum_from_matrix(scene_view_projection());
+            auto visible = std::make_shared<std::vector<uint32_t>>();
+            return std::function<void()>([bvh, view_frustum, visible]() {
+                visible->clear();
+                bvh->query_frustum(view_frustum, *visible);
+                keep(visible->size());
+            });
+        }, 1048576 },
+        { "cull_grid", [](size_t batch) {
+            // moves every object like the dynamic path in update_draw_transform, then queries
+            auto positions = scene_positions(batch);
+            auto grid = std::make_shared<loose_grid>(4.f);
+            auto extent = pyramid_bounds.extent();
+            auto half_extent = glm::max(extent.x, glm::max(extent.y, extent.z));
+            for (size_t i = 0; i < batch; i++) grid->insert(i, positions[i] + pyramid_bounds.center(), half_extent);
+            auto view_frustum = frustum_from_matrix(scene_view_projection());
+            auto visible = std::make_shared<std::vector<uint32_t>>();
+            return std::function<void()>([positions, grid, view_frustum, visible]() {
+                for (size_t i = 0; i < positions.size(); i++) grid->move(i, positions[i] + pyramid_bounds.center());
+                visible->clear();
+                grid->query_frustum(view_frustum, *visible);
+                keep(visible->size());
+            });
+        } },
+        { "cull_occlusion", [](size_t batch) {
+            // rasterizes every object as an occluder, then tests every box
+            auto positions = scene_positions(batch);
+            auto view_projection = scene_view_projection();
+            auto occlusion = std::make_shared<occlusion_buffer>(128, 128, &workers);
+            return std::function<void()>([positions, view_projection, occlusion]() {
+                occlusion->begin_frame(view_projection);
+                for (const auto& p : positions) {
+                    occlusion->add_occluder(pyramid, pyramid.indices.data(), pyramid.indices.size(), object_model_matrix(p));
+                }
+                occlusion->rasterize();
+                unsigned int visible = 0;
+                for (const auto& p : positions) visible += occlusion->test_aabb(aabb_translate(pyramid_bounds, p));
+                keep(visible);
+            });
+        } },
+        { "sort_draws", [](size_t batch) {
+            // the front to back draw list, built in the frame arena like
+            // main.cpp's, with the distances on the pool
+            auto positions = std::make_shared<std::vector<glm::vec3>>(scene_positions(batch));
+            auto arena = std::make_shared<frame_arena>(batch * sizeof(draw_item));
+            return std::function<void()>([positions, arena]() {
+                heap_tracker.begin_frame();
+                arena->begin_frame();
+                frame_vector<draw_item> draws(positions->size(), draw_item {}, frame_allocator<draw_item>(arena.get()));
+                auto points = positions->data();
+                auto items = draws.data();
+                workers.parallel_for(draws.size(), 1024, [points, items](unsigned int from, unsigned int to) {
+                    for (auto i = from; i < to; i++) items[i] = draw_item { i, glm::length(points[i]) };
+                });
+                std::sort(draws.begin(), draws.end(), [](const draw_item& a, const draw_item& b) {
+                    return a.distance < b.distance;
+                });
+                keep(draws.front());
+                heap_tracker.end_frame();
+            });
+        } },
+    };
+}
+
+// seconds per call of work, best of three runs of at least min_time each
+double measure(const std::function<void()>& work, double min_time) {
+    using clock = std::chrono::steady_clock;
+    work(); // warm caches and lazily built state
+    double best = 1e30;
+    for (int run = 0; run < 3; run++) {
+        size_t calls = 0;
+        auto start = clock::now();
+        double elapsed = 0.0;
+        do {
+            work();
+            calls++;
+            elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        } while (elapsed < min_time);
+        best = std::min(best, elapsed / calls);
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    const char* filter = nullptr;
+    double min_time = 0.05;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--min-time") && i + 1 < argc) min_time = atof(argv[++i]);
+        else filter = argv[i];
+    }
+
+    printf("%-16s %8s %14s %14s\n", "kernel", "batch", "ns/item", "items/s");
+    for (const auto& bench : microbenchmarks()) {
+        if (filter && !strstr(bench.name, filter)) continue;
+        for (auto batch : batch_sizes) {
+            if (batch > bench.max_batch) break;
+            heap_tracker = allocation_tracker();
+            auto work = bench.setup(batch);
+            auto seconds = measure(work, min_time);
+            printf("%-16s %8zu %14.2f %14.0f\n", bench.name, batch, 1e9 * seconds / batch, batch / seconds);
+            // the warm-up call may still grow the pool's queues
+            if (heap_tracker.dirty_frames > 1) {
+                printf("[microbench] Error: %s touched the heap in {%llu} of {%llu} frames\n", bench.name,
+                        (unsigned long long)heap_tracker.dirty_frames, (unsigned long long)heap_tracker.frames);
+            }
+        }
+    }
+    return 0;
+}
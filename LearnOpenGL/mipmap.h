@@ -0,0 +1,241 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MIPMAP_SSE 1
+#endif
+
+// CPU mip chain generation for RGBA8 images.
+//
+// Levels are filtered in linear light from the previous level, one pixel per
+// 4-wide vector, with either a 2x2 box or an 8-tap Kaiser-windowed sinc.
+// Cutout textures can keep the alpha-tested coverage of level 0 on every
+// level (Castano's scaling), so they don't fade away in the distance.
+
+enum class mip_filter { box, kaiser };
+
+struct mip_options {
+    mip_filter filter = mip_filter::kaiser;
+    bool srgb = true;          // rgb is sRGB encoded; alpha is always linear
+    float alpha_cutoff = -1.f; // alpha test threshold to preserve coverage for, negative to skip
+};
+
+inline int mip_level_count(int width, int height) {
+    int count = 1;
+    while (width > 1 || height > 1) {
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+        count++;
+    }
+    return count;
+}
+
+// Chains are RGBA8 levels packed back to back, level 0 first; this is the
+// byte offset of a level, and of one past the last level for level_count
+inline size_t mip_level_offset(int width, int height, int level) {
+    size_t offset = 0;
+    for (int i = 0; i < level; i++) {
+        offset += (size_t)width * height * 4;
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    return offset;
+}
+
+inline size_t mip_chain_size(int width, int height) {
+    return mip_level_offset(width, height, mip_level_count(width, height));
+}
+
+#ifdef MIPMAP_SSE
+typedef __m128 mip_pixel;
+inline mip_pixel mip_load(const float* p) { return _mm_loadu_ps(p); }
+inline void mip_store(float* p, mip_pixel v) { _mm_storeu_ps(p, v); }
+inline mip_pixel mip_zero() { return _mm_setzero_ps(); }
+inline mip_pixel mip_madd(mip_pixel acc, mip_pixel v, float w) { return _mm_add_ps(acc, _mm_mul_ps(v, _mm_set1_ps(w))); }
+#else
+struct mip_pixel { float c[4]; };
+inline mip_pixel mip_load(const float* p) { return mip_pixel { { p[0], p[1], p[2], p[3] } }; }
+inline void mip_store(float* p, mip_pixel v) { for (int i = 0; i < 4; i++) p[i] = v.c[i]; }
+inline mip_pixel mip_zero() { return mip_pixel { { 0.f, 0.f, 0.f, 0.f } }; }
+inline mip_pixel mip_madd(mip_pixel acc, mip_pixel v, float w) {
+    for (int i = 0; i < 4; i++) acc.c[i] += v.c[i] * w;
+    return acc;
+}
+#endif
+
+inline const float* srgb_to_linear_table() {
+    static const auto table = [] {
+        std::vector<float> t(256);
+        for (int i = 0; i < 256; i++) {
+            auto c = i / 255.f;
+            t[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+// indexed by linear * 4095; fine enough that every byte value stays reachable
+inline const unsigned char* linear_to_srgb_table() {
+    static const auto table = [] {
+        std::vector<unsigned char> t(4096);
+        for (int i = 0; i < 4096; i++) {
+            auto c = i / 4095.f;
+            auto s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+            t[i] = (unsigned char)(s * 255.f + 0.5f);
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+// weights for source pixels 2x-3 .. 2x+4 of destination pixel x
+inline const float* kaiser_weights() {
+    static const auto weights = [] {
+        const double alpha = 4.0, support = 2.0, pi = 3.14159265358979323846;
+        auto bessel_i0 = [](double x) {
+            double sum = 1.0, term = 1.0;
+            for (int k = 1; k < 20; k++) {
+                term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                sum += term;
+            }
+            return sum;
+        };
+        std::vector<float> w(8);
+        double total = 0.0;
+        for (int k = 0; k < 8; k++) {
+            auto d = (k - 3.5) / 2.0; // in destination pixels
+            auto sinc = std::sin(pi * d) / (pi * d);
+            auto r = d / support;
+            auto window = bessel_i0(alpha * std::sqrt(std::max(0.0, 1.0 - r * r))) / bessel_i0(alpha);
+            w[k] = (float)(sinc * window);
+            total += w[k];
+        }
+        for (auto& x : w) x = (float)(x / total);
+        return w;
+    }();
+    return weights.data();
+}
+
+// src is sw x sh float RGBA, dst is max(sw / 2, 1) x max(sh / 2, 1)
+inline void downsample_level(const std::vector<float>& src, int sw, int sh, std::vector<float>& dst, mip_filter filter) {
+    auto dw = std::max(sw / 2, 1), dh = std::max(sh / 2, 1);
+    dst.resize((size_t)dw * dh * 4);
+
+    if (filter == mip_filter::box) {
+        for (int y = 0; y < dh; y++) {
+            auto y0 = std::min(y * 2, sh - 1), y1 = std::min(y * 2 + 1, sh - 1);
+            for (int x = 0; x < dw; x++) {
+                auto x0 = std::min(x * 2, sw - 1), x1 = std::min(x * 2 + 1, sw - 1);
+                auto acc = mip_zero();
+                acc = mip_madd(acc, mip_load(&src[((size_t)y0 * sw + x0) * 4]), 0.25f);
+                acc = mip_madd(acc, mip_load(&src[((size_t)y0 * sw + x1) * 4]), 0.25f);
+                acc = mip_madd(acc, mip_load(&src[((size_t)y1 * sw + x0) * 4]), 0.25f);
+                acc = mip_madd(acc, mip_load(&src[((size_t)y1 * sw + x1) * 4]), 0.25f);
+                mip_store(&dst[((size_t)y * dw + x) * 4], acc);
+            }
+        }
+        return;
+    }
+
+    // separable, clamped at the edges; an axis that can't shrink is passed through
+    auto w = kaiser_weights();
+    std::vector<float> rows((size_t)dw * sh * 4);
+    for (int y = 0; y < sh; y++) {
+        const float* row = &src[(size_t)y * sw * 4];
+        for (int x = 0; x < dw; x++) {
+            auto acc = mip_zero();
+            if (sw == 1) acc = mip_load(row);
+            else for (int k = 0; k < 8; k++) {
+                auto sx = std::min(std::max(x * 2 - 3 + k, 0), sw - 1);
+                acc = mip_madd(acc, mip_load(&row[sx * 4]), w[k]);
+            }
+            mip_store(&rows[((size_t)y * dw + x) * 4], acc);
+        }
+    }
+    for (int y = 0; y < dh; y++) {
+        for (int x = 0; x < dw; x++) {
+            auto acc = mip_zero();
+            if (sh == 1) acc = mip_load(&rows[(size_t)x * 4]);
+            else for (int k = 0; k < 8; k++) {
+                auto sy = std::min(std::max(y * 2 - 3 + k, 0), sh - 1);
+                acc = mip_madd(acc, mip_load(&rows[((size_t)sy * dw + x) * 4]), w[k]);
+            }
+            mip_store(&dst[((size_t)y * dw + x) * 4], acc);
+        }
+    }
+}
+
+inline float alpha_coverage(const std::vector<float>& level, float scale, float cutoff) {
+    size_t covered = 0, count = level.size() / 4;
+    for (size_t i = 0; i < count; i++) covered += level[i * 4 + 3] * scale > cutoff;
+    return (float)covered / count;
+}
+
+// alpha scale that makes the level cover about `target` of its pixels at the cutoff
+inline float alpha_coverage_scale(const std::vector<float>& level, float cutoff, float target) {
+    float lo = 0.f, hi = 4.f;
+    for (int i = 0; i < 12; i++) {
+        auto mid = 0.5f * (lo + hi);
+        if (alpha_coverage(level, mid, cutoff) < target) lo = mid;
+        else hi = mid;
+    }
+    return 0.5f * (lo + hi);
+}
+
+inline void encode_level(const std::vector<float>& linear, int width, int height, bool srgb, float alpha_scale,
+        unsigned char* out) {
+    auto to_srgb = linear_to_srgb_table();
+    auto count = (size_t)width * height * 4;
+    for (size_t i = 0; i < count; i += 4) {
+        for (int c = 0; c < 3; c++) {
+            auto v = std::min(std::max(linear[i + c], 0.f), 1.f);
+            out[i + c] = srgb ? to_srgb[(int)(v * 4095.f + 0.5f)] : (unsigned char)(v * 255.f + 0.5f);
+        }
+        auto a = std::min(std::max(linear[i + 3] * alpha_scale, 0.f), 1.f);
+        out[i + 3] = (unsigned char)(a * 255.f + 0.5f);
+    }
+}
+
+// Writes levels first_level and up to out, packed back to back, which needs
+// mip_chain_size() - mip_level_offset(first_level) bytes. out is written once
+// and never read back, so it can be write-combined mapped memory.
+// Skipped levels are still filtered, since each level comes from the one
+// above it; first_level saves the encoding and the output, not the work.
+inline void build_mip_chain(const unsigned char* rgba, int width, int height, const mip_options& options,
+        unsigned char* out, int first_level = 0) {
+    auto level_count = mip_level_count(width, height);
+    if (first_level == 0) {
+        memcpy(out, rgba, (size_t)width * height * 4);
+        out += (size_t)width * height * 4;
+    }
+
+    auto to_linear = srgb_to_linear_table();
+    std::vector<float> current((size_t)width * height * 4), next;
+    for (size_t i = 0; i < current.size(); i += 4) {
+        for (int c = 0; c < 3; c++) current[i + c] = options.srgb ? to_linear[rgba[i + c]] : rgba[i + c] / 255.f;
+        current[i + 3] = rgba[i + 3] / 255.f;
+    }
+    auto keep_coverage = options.alpha_cutoff >= 0.f;
+    auto coverage = keep_coverage ? alpha_coverage(current, 1.f, options.alpha_cutoff) : 0.f;
+
+    // each level filters the unscaled previous one so coverage fixes don't compound
+    for (int level = 1; level < level_count; level++) {
+        downsample_level(current, width, height, next, options.filter);
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+        std::swap(current, next);
+        if (level < first_level) continue;
+        auto scale = keep_coverage ? alpha_coverage_scale(current, options.alpha_cutoff, coverage) : 1.f;
+        encode_level(current, width, height, options.srgb, scale, out);
+        out += (size_t)width * height * 4;
+    }
+}
+
+#endif
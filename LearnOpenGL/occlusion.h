@@ -0,0 +1,356 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// With GCC and Clang the AVX2 span kernel is compiled on its own and picked
+// at runtime, so one binary still runs on CPUs without it; other compilers
+// only use it when the whole build targets AVX2 (LEARNOPENGL_AVX2).
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define OCCLUSION_AVX2 1
+#define OCCLUSION_AVX2_TARGET __attribute__((target("avx2,fma")))
+#elif defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define OCCLUSION_AVX2 1
+#define OCCLUSION_AVX2_TARGET
+#endif
+
+#include "glm/glm.hpp"
+#include "bounds.h"
+#include "mesh.h"
+#include "thread_pool.h"
+
+// Software occlusion culling. Designated occluders are rasterized on the CPU
+// into a small depth buffer, and object bounds are tested against it before
+// anything is submitted to GL.
+//
+// The buffer is split into tiles. add_occluder only queues an occluder;
+// rasterize() transforms and bins the queued triangles per tile, split into
+// groups of occluders that are set up in parallel, each group with bins of
+// its own so no task waits on another. Then it fills tiles in parallel, 8 pixels at a time with
+// AVX2 when the CPU has it. Each tile also keeps its farthest depth so most tests
+// against fully covered tiles never touch individual pixels.
+// Depth is window depth in [0, 1], smaller is closer.
+
+inline bool occlusion_has_avx2() {
+#if defined(OCCLUSION_AVX2) && defined(__GNUC__) && !(defined(__AVX2__) && defined(__FMA__))
+    // buffers can be globals, constructed before the runtime has probed the CPU
+    static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"));
+    return supported;
+#elif defined(OCCLUSION_AVX2)
+    return true;
+#else
+    return false;
+#endif
+}
+
+struct occlusion_stats {
+    unsigned int occluder_triangles; // binned after clipping
+    unsigned int tests;
+    unsigned int culled;
+};
+
+class occlusion_buffer {
+    public:
+        static constexpr int tile_width = 32;
+        static constexpr int tile_height = 8;
+
+    private:
+        struct screen_triangle {
+            // edge functions e = a*x + b*y + c, inside when all three are >= 0
+            float edge_a[3], edge_b[3], edge_c[3];
+            // conservative (farthest within the pixel) depth plane
+            float z_a, z_b, z_c;
+            int min_x, min_y, max_x, max_y;
+        };
+
+        int width, height;
+        int tiles_x, tiles_y;
+        thread_pool* pool;
+        bool use_avx2 = occlusion_has_avx2();
+
+        glm::mat4 view_projection;
+        std::vector<float> depth;
+        std::vector<float> tile_max;
+        struct occluder {
+            const mesh_data* mesh;
+            const unsigned int* indices;
+            unsigned int index_count;
+            glm::mat4 mvp;
+        };
+
+        // triangles of a run of occluders, set up by one task
+        struct bin_group {
+            std::vector<screen_triangle> triangles;
+            std::vector<std::vector<unsigned int>> bins; // per tile, into triangles
+            std::vector<glm::vec4> clip_scratch;
+        };
+
+        static constexpr unsigned int max_groups = 16;
+
+        std::vector<occluder> occluders;
+        std::vector<bin_group> groups; // max_groups, the first group_count in use
+        unsigned int group_count = 0;
+
+        glm::vec3 to_screen(glm::vec4 clip) const {
+            auto ndc = glm::vec3(clip) / clip.w;
+            return glm::vec3((ndc.x * 0.5f + 0.5f) * width,
+                    (ndc.y * 0.5f + 0.5f) * height,
+                    ndc.z * 0.5f + 0.5f);
+        }
+
+        void setup_triangle(bin_group& group, glm::vec3 v0, glm::vec3 v1, glm::vec3 v2) {
+            auto area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+            if (std::fabs(area) < 1e-6f) return;
+            // occluders are treated as two sided
+            if (area < 0) {
+                std::swap(v1, v2);
+                area = -area;
+            }
+
+            screen_triangle tri;
+            tri.min_x = std::max(0, (int)std::ceil(std::min({ v0.x, v1.x, v2.x }) - 0.5f));
+            tri.min_y = std::max(0, (int)std::ceil(std::min({ v0.y, v1.y, v2.y }) - 0.5f));
+            tri.max_x = std::min(width - 1, (int)std::floor(std::max({ v0.x, v1.x, v2.x }) - 0.5f));
+            tri.max_y = std::min(height - 1, (int)std::floor(std::max({ v0.y, v1.y, v2.y }) - 0.5f));
+            if (tri.min_x > tri.max_x || tri.min_y > tri.max_y) return;
+
+            glm::vec3 v[3] = { v0, v1, v2 };
+            for (int i = 0; i < 3; i++) {
+                auto from = v[i];
+                auto to = v[(i + 1) % 3];
+                tri.edge_a[i] = -(to.y - from.y);
+                tri.edge_b[i] = to.x - from.x;
+                tri.edge_c[i] = (to.y - from.y) * from.x - (to.x - from.x) * from.y;
+            }
+
+            auto dzdx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+            auto dzdy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+            tri.z_a = dzdx;
+            tri.z_b = dzdy;
+            tri.z_c = v0.z - dzdx * v0.x - dzdy * v0.y + 0.5f * (std::fabs(dzdx) + std::fabs(dzdy));
+
+            auto index = (unsigned int)group.triangles.size();
+            group.triangles.push_back(tri);
+            for (int ty = tri.min_y / tile_height; ty <= tri.max_y / tile_height; ty++) {
+                for (int tx = tri.min_x / tile_width; tx <= tri.max_x / tile_width; tx++) {
+                    group.bins[ty * tiles_x + tx].push_back(index);
+                }
+            }
+        }
+
+        // one triangle over pixels [min_x, max_x] x [min_y, max_y] of the buffer,
+        // min_x 8-aligned within its tile so spans never leave the tile
+#ifdef OCCLUSION_AVX2
+        OCCLUSION_AVX2_TARGET
+        static void fill_avx2(const screen_triangle& tri, float* depth, int width,
+                int min_x, int max_x, int min_y, int max_y) {
+            auto lanes = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+            for (int y = min_y; y <= max_y; y++) {
+                auto row = depth + y * width;
+                auto ys = _mm256_set1_ps(y + 0.5f);
+                for (int x = min_x; x <= max_x; x += 8) {
+                    auto xs = _mm256_add_ps(_mm256_set1_ps((float)x), lanes);
+                    auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+                    for (int i = 0; i < 3; i++) {
+                        auto e = _mm256_fmadd_ps(_mm256_set1_ps(tri.edge_a[i]), xs,
+                                _mm256_fmadd_ps(_mm256_set1_ps(tri.edge_b[i]), ys, _mm256_set1_ps(tri.edge_c[i])));
+                        inside = _mm256_and_ps(inside, _mm256_cmp_ps(e, _mm256_setzero_ps(), _CMP_GE_OQ));
+                    }
+                    if (_mm256_movemask_ps(inside) == 0) continue;
+                    auto z = _mm256_fmadd_ps(_mm256_set1_ps(tri.z_a), xs,
+                            _mm256_fmadd_ps(_mm256_set1_ps(tri.z_b), ys, _mm256_set1_ps(tri.z_c)));
+                    auto current = _mm256_loadu_ps(row + x);
+                    auto closer = _mm256_min_ps(current, z);
+                    _mm256_storeu_ps(row + x, _mm256_blendv_ps(current, closer, inside));
+                }
+            }
+        }
+#endif
+
+        static void fill_scalar(const screen_triangle& tri, float* depth, int width,
+                int min_x, int max_x, int min_y, int max_y) {
+            for (int y = min_y; y <= max_y; y++) {
+                auto row = depth + y * width;
+                float py = y + 0.5f;
+                for (int x = min_x; x < min_x + ((max_x - min_x) / 8 + 1) * 8; x++) {
+                    float px = x + 0.5f;
+                    bool inside = true;
+                    for (int e = 0; e < 3; e++) {
+                        inside &= tri.edge_a[e] * px + tri.edge_b[e] * py + tri.edge_c[e] >= 0.f;
+                    }
+                    if (!inside) continue;
+                    auto z = tri.z_a * px + tri.z_b * py + tri.z_c;
+                    row[x] = std::min(row[x], z);
+                }
+            }
+        }
+
+        // the part of tri inside the tile at x0, y0
+        void fill_triangle(const screen_triangle& tri, int x0, int y0) {
+            int min_x = std::max(tri.min_x, x0);
+            int max_x = std::min(tri.max_x, x0 + tile_width - 1);
+            int min_y = std::max(tri.min_y, y0);
+            int max_y = std::min(tri.max_y, y0 + tile_height - 1);
+            min_x -= (min_x - x0) % 8;
+#ifdef OCCLUSION_AVX2
+            if (use_avx2) {
+                fill_avx2(tri, depth.data(), width, min_x, max_x, min_y, max_y);
+                return;
+            }
+#endif
+            fill_scalar(tri, depth.data(), width, min_x, max_x, min_y, max_y);
+        }
+
+        // transforms, clips and bins occluders [begin, end) into group
+        void setup_group(bin_group& group, unsigned int begin, unsigned int end) {
+            group.triangles.clear();
+            for (auto& bin : group.bins) bin.clear();
+            for (auto o = begin; o < end; o++) {
+                const auto& occluder = occluders[o];
+                const auto& mesh = *occluder.mesh;
+                group.clip_scratch.resize(mesh.vertex_count());
+                for (unsigned int i = 0; i < mesh.vertex_count(); i++) {
+                    group.clip_scratch[i] = occluder.mvp * glm::vec4(mesh.position(i), 1.f);
+                }
+
+                auto indices = occluder.indices;
+                for (unsigned int i = 0; i + 2 < occluder.index_count; i += 3) {
+                    const glm::vec4* clip[3] = {
+                        &group.clip_scratch[indices[i]], &group.clip_scratch[indices[i + 1]],
+                        &group.clip_scratch[indices[i + 2]]
+                    };
+                    // anything reaching past the near plane is dropped rather than
+                    // clipped; losing an occluder is safe, over-occluding is not
+                    bool crosses_near = false;
+                    for (auto c : clip) crosses_near |= c->w <= 1e-5f || c->z < -c->w;
+                    if (crosses_near) continue;
+                    setup_triangle(group, to_screen(*clip[0]), to_screen(*clip[1]), to_screen(*clip[2]));
+                }
+            }
+        }
+
+        void rasterize_tile(int tile) {
+            int x0 = (tile % tiles_x) * tile_width;
+            int y0 = (tile / tiles_x) * tile_height;
+            for (int y = y0; y < y0 + tile_height; y++) {
+                std::fill_n(&depth[y * width + x0], tile_width, 1.f);
+            }
+
+            for (unsigned int g = 0; g < group_count; g++) {
+                for (auto index : groups[g].bins[tile]) {
+                    fill_triangle(groups[g].triangles[index], x0, y0);
+                }
+            }
+
+            float farthest = 0.f;
+            for (int y = y0; y < y0 + tile_height; y++) {
+                for (int x = x0; x < x0 + tile_width; x++) {
+                    farthest = std::max(farthest, depth[y * width + x]);
+                }
+            }
+            tile_max[tile] = farthest;
+        }
+
+    public:
+        occlusion_stats stats;
+
+        // width and height are rounded up to whole tiles
+        occlusion_buffer(int width = 256, int height = 128, thread_pool* pool = nullptr)
+            : pool(pool) {
+            tiles_x = (width + tile_width - 1) / tile_width;
+            tiles_y = (height + tile_height - 1) / tile_height;
+            this->width = tiles_x * tile_width;
+            this->height = tiles_y * tile_height;
+            depth.assign(this->width * this->height, 1.f);
+            tile_max.assign(tiles_x * tiles_y, 1.f);
+            groups.resize(max_groups);
+            for (auto& group : groups) group.bins.resize(tiles_x * tiles_y);
+        }
+
+        int get_width() const { return width; }
+        int get_height() const { return height; }
+        const float* depth_data() const { return depth.data(); }
+
+        void begin_frame(const glm::mat4& view_projection) {
+            this->view_projection = view_projection;
+            occluders.clear();
+            group_count = 0;
+            stats = occlusion_stats {};
+        }
+
+        // queues the occluder for rasterize(); mesh and indices have to stay
+        // alive until then
+        void add_occluder(const mesh_data& mesh, const unsigned int* indices,
+                unsigned int index_count, const glm::mat4& model) {
+            occluders.push_back(occluder { &mesh, indices, index_count, view_projection * model });
+        }
+
+        void rasterize() {
+            auto occluder_count = (unsigned int)occluders.size();
+            group_count = std::min(max_groups, occluder_count);
+            auto setup = [this, occluder_count](unsigned int begin, unsigned int end) {
+                for (auto g = begin; g < end; g++) {
+                    auto first = g * occluder_count / group_count;
+                    setup_group(groups[g], first, (g + 1) * occluder_count / group_count);
+                }
+            };
+            if (pool) pool->parallel_for(group_count, 1, setup);
+            else setup(0, group_count);
+            for (unsigned int g = 0; g < group_count; g++) stats.occluder_triangles += groups[g].triangles.size();
+
+            auto tile_count = (unsigned int)(tiles_x * tiles_y);
+            auto work = [this](unsigned int begin, unsigned int end) {
+                for (auto tile = begin; tile < end; tile++) rasterize_tile(tile);
+            };
+            if (pool) pool->parallel_for(tile_count, 8, work);
+            else work(0, tile_count);
+        }
+
+        // false only when every pixel the box covers has an occluder in front of it
+        bool test_aabb(const aabb& box) {
+            stats.tests++;
+            auto lo = glm::vec3(1e30f);
+            auto hi = glm::vec3(-1e30f);
+            for (int i = 0; i < 8; i++) {
+                auto corner = glm::vec3(i & 1 ? box.max.x : box.min.x,
+                        i & 2 ? box.max.y : box.min.y,
+                        i & 4 ? box.max.z : box.min.z);
+                auto clip = view_projection * glm::vec4(corner, 1.f);
+                if (clip.w <= 1e-5f || clip.z < -clip.w) return true;
+                auto screen = to_screen(clip);
+                lo = glm::min(lo, screen);
+                hi = glm::max(hi, screen);
+            }
+
+            int min_x = std::max(0, (int)std::floor(lo.x));
+            int min_y = std::max(0, (int)std::floor(lo.y));
+            int max_x = std::min(width - 1, (int)std::ceil(hi.x) - 1);
+            int max_y = std::min(height - 1, (int)std::ceil(hi.y) - 1);
+            // off screen is the frustum's problem, not ours
+            if (min_x > max_x || min_y > max_y) return true;
+
+            auto nearest = lo.z;
+            for (int ty = min_y / tile_height; ty <= max_y / tile_height; ty++) {
+                for (int tx = min_x / tile_width; tx <= max_x / tile_width; tx++) {
+                    if (tile_max[ty * tiles_x + tx] < nearest) continue;
+                    int x0 = std::max(min_x, tx * tile_width);
+                    int x1 = std::min(max_x, tx * tile_width + tile_width - 1);
+                    int y0 = std::max(min_y, ty * tile_height);
+                    int y1 = std::min(max_y, ty * tile_height + tile_height - 1);
+                    for (int y = y0; y <= y1; y++) {
+                        for (int x = x0; x <= x1; x++) {
+                            if (depth[y * width + x] >= nearest) return true;
+                        }
+                    }
+                }
+            }
+            stats.culled++;
+            return false;
+        }
+};
+
+#endif
@@ -0,0 +1,223 @@
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "sampler.h"
+
+// Performance overlay: text and bar graphs batched into one vertex buffer
+// and drawn with a single draw call over the finished frame.
+//
+// Text uses a built-in 3x5 pixel font covering ' ' to '_' (digits, upper
+// case and punctuation; lower case prints as upper case), so the overlay
+// needs no font file. Glyphs live in one small R8 texture that also holds a
+// solid block, which is what rectangles and bars sample.
+
+// rows top to bottom, 4 is the left column
+const unsigned char overlay_font[65][5] = {
+    { 0, 0, 0, 0, 0 }, { 2, 2, 2, 0, 2 }, { 5, 5, 0, 0, 0 }, { 5, 7, 5, 7, 5 }, // space ! " #
+    { 3, 6, 2, 3, 6 }, { 5, 1, 2, 4, 5 }, { 2, 5, 2, 5, 3 }, { 2, 2, 0, 0, 0 }, // $ % & '
+    { 1, 2, 2, 2, 1 }, { 4, 2, 2, 2, 4 }, { 0, 5, 2, 5, 0 }, { 0, 2, 7, 2, 0 }, // ( ) * +
+    { 0, 0, 0, 2, 4 }, { 0, 0, 7, 0, 0 }, { 0, 0, 0, 0, 2 }, { 1, 1, 2, 4, 4 }, // , - . /
+    { 7, 5, 5, 5, 7 }, { 2, 6, 2, 2, 7 }, { 7, 1, 7, 4, 7 }, { 7, 1, 7, 1, 7 }, // 0 1 2 3
+    { 5, 5, 7, 1, 1 }, { 7, 4, 7, 1, 7 }, { 7, 4, 7, 5, 7 }, { 7, 1, 1, 1, 1 }, // 4 5 6 7
+    { 7, 5, 7, 5, 7 }, { 7, 5, 7, 1, 7 }, { 0, 2, 0, 2, 0 }, { 0, 2, 0, 2, 4 }, // 8 9 : ;
+    { 1, 2, 4, 2, 1 }, { 0, 7, 0, 7, 0 }, { 4, 2, 1, 2, 4 }, { 7, 1, 2, 0, 2 }, // < = > ?
+    { 7, 5, 7, 4, 7 }, { 2, 5, 7, 5, 5 }, { 6, 5, 6, 5, 6 }, { 3, 4, 4, 4, 3 }, // @ A B C
+    { 6, 5, 5, 5, 6 }, { 7, 4, 6, 4, 7 }, { 7, 4, 6, 4, 4 }, { 3, 4, 5, 5, 3 }, // D E F G
+    { 5, 5, 7, 5, 5 }, { 7, 2, 2, 2, 7 }, { 1, 1, 1, 5, 2 }, { 5, 5, 6, 5, 5 }, // H I J K
+    { 4, 4, 4, 4, 7 }, { 5, 7, 7, 5, 5 }, { 6, 5, 5, 5, 5 }, { 2, 5, 5, 5, 2 }, // L M N O
+    { 6, 5, 6, 4, 4 }, { 2, 5, 5, 6, 3 }, { 6, 5, 6, 5, 5 }, { 3, 4, 2, 1, 6 }, // P Q R S
+    { 7, 2, 2, 2, 2 }, { 5, 5, 5, 5, 7 }, { 5, 5, 5, 5, 2 }, { 5, 5, 7, 7, 5 }, // T U V W
+    { 5, 5, 2, 5, 5 }, { 5, 5, 2, 2, 2 }, { 7, 1, 2, 4, 7 }, { 6, 4, 4, 4, 6 }, // X Y Z [
+    { 4, 4, 2, 1, 1 }, { 3, 1, 1, 1, 3 }, { 2, 5, 0, 0, 0 }, { 0, 0, 0, 0, 7 }, // \ ] ^ _
+    { 7, 7, 7, 7, 7 },                                                           // solid block
+};
+
+const int overlay_glyph_width = 3;
+const int overlay_glyph_height = 5;
+const int overlay_solid_glyph = 64;
+
+// packs 0-255 channels the way the color attribute reads them
+inline uint32_t overlay_color(unsigned int r, unsigned int g, unsigned int b, unsigned int a = 255) {
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+struct overlay_vertex {
+    float x, y; // pixels from the top left
+    float u, v;
+    uint32_t color;
+};
+
+// per-frame timings for the overlay graph, oldest first from next
+struct overlay_history {
+    static const unsigned int size = 120;
+    float frame_ms[size] = {};
+    float cpu_ms[size] = {};
+    float gpu_ms[size] = {};
+    unsigned int next = 0;
+
+    void push(float frame, float cpu, float gpu) {
+        frame_ms[next] = frame;
+        cpu_ms[next] = cpu;
+        gpu_ms[next] = gpu;
+        next = (next + 1) % size;
+    }
+
+    float last_gpu_ms() const { return gpu_ms[(next + size - 1) % size]; }
+};
+
+class perf_overlay {
+    private:
+        // atlas cells are one texel bigger than glyphs so filtering never bleeds
+        static const int cell_width = overlay_glyph_width + 1;
+        static const int cell_height = overlay_glyph_height + 1;
+        static const int atlas_width = 65 * cell_width;
+
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        GLuint font = 0;
+        std::vector<overlay_vertex> vertices; // reserved once, so frames don't allocate
+        size_t max_quads = 0;
+
+        void quad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, uint32_t color) {
+            if (vertices.size() + 6 > max_quads * 6) return;
+            overlay_vertex a { x0, y0, u0, v0, color }, b { x1, y0, u1, v0, color };
+            overlay_vertex c { x1, y1, u1, v1, color }, d { x0, y1, u0, v1, color };
+            vertices.push_back(a);
+            vertices.push_back(b);
+            vertices.push_back(c);
+            vertices.push_back(a);
+            vertices.push_back(c);
+            vertices.push_back(d);
+        }
+
+        void glyph(float x, float y, int index, uint32_t color) {
+            auto u0 = (float)(index * cell_width) / atlas_width;
+            auto u1 = (float)(index * cell_width + overlay_glyph_width) / atlas_width;
+            auto v1 = (float)overlay_glyph_height / cell_height;
+            quad(x, y, x + overlay_glyph_width * scale, y + overlay_glyph_height * scale, u0, 0.f, u1, v1, color);
+        }
+
+    public:
+        float scale = 2.f; // screen pixels per font pixel
+        sampler_desc sampler = clamped_sampler();
+
+        perf_overlay() {
+            sampler.min_filter = GL_NEAREST;
+            sampler.mag_filter = GL_NEAREST;
+        }
+
+        float line_height() const { return (overlay_glyph_height + 2) * scale; }
+
+        void init(size_t quad_capacity = 4096) {
+            max_quads = quad_capacity;
+            vertices.reserve(max_quads * 6);
+
+            unsigned char texels[cell_height][atlas_width] = {};
+            for (int g = 0; g < 65; g++) {
+                for (int row = 0; row < overlay_glyph_height; row++) {
+                    for (int column = 0; column < overlay_glyph_width; column++) {
+                        if (overlay_font[g][row] & (4 >> column)) texels[row][g * cell_width + column] = 255;
+                    }
+                }
+            }
+            glGenTextures(1, &font);
+            glBindTexture(GL_TEXTURE_2D, font);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlas_width, cell_height, 0, GL_RED, GL_UNSIGNED_BYTE, texels);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+            glGenVertexArrays(1, &vao);
+            glBindVertexArray(vao);
+            glGenBuffers(1, &vbo);
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glBufferData(GL_ARRAY_BUFFER, max_quads * 6 * sizeof(overlay_vertex), nullptr, GL_STREAM_DRAW);
+            auto stride = sizeof(overlay_vertex);
+            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(overlay_vertex, x));
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(overlay_vertex, u));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(overlay_vertex, color));
+            glEnableVertexAttribArray(2);
+        }
+
+        void begin() { vertices.clear(); }
+
+        size_t quads() const { return vertices.size() / 6; }
+
+        void rect(float x, float y, float w, float h, uint32_t color) {
+            // center of the solid block, so nearest sampling always hits it
+            auto u = (overlay_solid_glyph * cell_width + 1.5f) / atlas_width;
+            auto v = 2.5f / cell_height;
+            quad(x, y, x + w, y + h, u, v, u, v, color);
+        }
+
+        // printf-style; returns the x after the last character
+        float text(float x, float y, uint32_t color, const char* format, ...) {
+            char line[256];
+            va_list args;
+            va_start(args, format);
+            vsnprintf(line, sizeof(line), format, args);
+            va_end(args);
+            for (const char* c = line; *c; c++, x += cell_width * scale) {
+                int ch = *c >= 'a' && *c <= 'z' ? *c - 'a' + 'A' : *c;
+                if (ch == ' ') continue;
+                glyph(x, y, ch >= ' ' && ch <= '_' ? ch - ' ' : '?' - ' ', color);
+            }
+            return x;
+        }
+
+        // one bar per value, left to right from first (wrapping), clamped to max_value
+        void graph(float x, float y, float w, float h, const float* values, unsigned int count,
+                unsigned int first, float max_value, uint32_t color) {
+            auto bar = w / count;
+            for (unsigned int i = 0; i < count; i++) {
+                auto value = std::min(values[(first + i) % count] / max_value, 1.f) * h;
+                if (value > 0.f) rect(x + i * bar, y + h - value, std::max(bar - 1.f, 1.f), value, color);
+            }
+        }
+
+        // everything since begin() in one draw call; leaves depth testing on
+        // and blending off like the scene expects
+        void draw(GLuint program, float width, float height, GLuint unit, sampler_cache& samplers) {
+            if (vertices.empty() || !program) return;
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            // orphaned so the driver doesn't wait for last frame's draw
+            glBufferData(GL_ARRAY_BUFFER, max_quads * 6 * sizeof(overlay_vertex), nullptr, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(overlay_vertex), vertices.data());
+
+            glUseProgram(program);
+            glUniform2f(glGetUniformLocation(program, "screen_size"), width, height);
+            glUniform1i(glGetUniformLocation(program, "font"), unit);
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D, font);
+            samplers.bind(unit, sampler);
+            glActiveTexture(GL_TEXTURE0);
+
+            glDisable(GL_DEPTH_TEST);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glBindVertexArray(vao);
+            glDrawArrays(GL_TRIANGLES, 0, vertices.size());
+            glDisable(GL_BLEND);
+            glEnable(GL_DEPTH_TEST);
+        }
+
+        // call while the context is still current
+        void release() {
+            if (vao) glDeleteVertexArrays(1, &vao);
+            if (vbo) glDeleteBuffers(1, &vbo);
+            if (font) glDeleteTextures(1, &font);
+            vao = vbo = font = 0;
+        }
+};
+
+#endif
@@ -0,0 +1,111 @@
+// Packs a directory into one asset archive (see archive.h).
+//
+//   pack_assets <directory> <prefix> <archive>
+//
+// Every file under directory is stored under prefix/<relative path>, so with
+// the prefix "data" paths match what the renderer opens from the working
+// directory. Entries are LZ4 compressed when that saves at least an eighth.
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "archive.h"
+
+namespace fs = std::filesystem;
+
+struct packed_file {
+    std::string name;
+    std::vector<unsigned char> bytes;
+    archive_entry entry;
+};
+
+int main(int argc, char** argv) {
+    if (argc != 4) {
+        printf("usage: pack_assets <directory> <prefix> <archive>\n");
+        return 1;
+    }
+    fs::path root(argv[1]);
+    std::string prefix(argv[2]);
+
+    std::vector<packed_file> files;
+    size_t original_total = 0;
+    for (const auto& item : fs::recursive_directory_iterator(root)) {
+        if (!item.is_regular_file()) continue;
+        packed_file file;
+        file.name = prefix + "/" + fs::relative(item.path(), root).generic_string();
+        std::ifstream in(item.path(), std::ios::binary);
+        file.bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        original_total += file.bytes.size();
+
+        file.entry = archive_entry {};
+        file.entry.hash = archive_hash(file.name.data(), file.name.size());
+        file.entry.original_size = file.bytes.size();
+        file.entry.compression = archive_stored;
+        std::vector<unsigned char> compressed(lz4_bound(file.bytes.size()));
+        auto compressed_size = lz4_compress(file.bytes.data(), file.bytes.size(), compressed.data());
+        if (compressed_size < file.bytes.size() - file.bytes.size() / 8) {
+            compressed.resize(compressed_size);
+            file.bytes.swap(compressed);
+            file.entry.compression = archive_lz4;
+        }
+        file.entry.size = file.bytes.size();
+        files.push_back(std::move(file));
+    }
+    // sorted by name first so the output doesn't depend on directory order
+    std::sort(files.begin(), files.end(), [](const packed_file& a, const packed_file& b) { return a.name < b.name; });
+
+    std::ofstream out(argv[3], std::ios::binary | std::ios::trunc);
+    if (!out) {
+        printf("[pack_assets] Error: can't write {%s}\n", argv[3]);
+        return 1;
+    }
+    auto pad_to = [&out](uint64_t alignment) {
+        static const char zeros[16] = {};
+        auto position = (uint64_t)out.tellp();
+        out.write(zeros, (alignment - position % alignment) % alignment);
+    };
+
+    archive_header header {};
+    memcpy(header.magic, archive_magic, sizeof(archive_magic));
+    header.version = archive_version;
+    header.entry_count = files.size();
+    out.write((const char*)&header, sizeof(header));
+
+    std::string names;
+    for (auto& file : files) {
+        pad_to(archive_alignment);
+        file.entry.offset = out.tellp();
+        file.entry.name_offset = names.size();
+        file.entry.name_length = file.name.size();
+        names += file.name;
+        out.write((const char*)file.bytes.data(), file.bytes.size());
+    }
+
+    std::vector<archive_entry> toc;
+    for (const auto& file : files) toc.push_back(file.entry);
+    std::stable_sort(toc.begin(), toc.end(), [](const archive_entry& a, const archive_entry& b) { return a.hash < b.hash; });
+    pad_to(alignof(archive_entry));
+    header.toc_offset = out.tellp();
+    out.write((const char*)toc.data(), toc.size() * sizeof(archive_entry));
+    header.names_offset = out.tellp();
+    header.names_size = names.size();
+    out.write(names.data(), names.size());
+
+    out.seekp(0);
+    out.write((const char*)&header, sizeof(header));
+    out.close();
+
+    size_t packed_total = 0;
+    for (const auto& file : files) {
+        packed_total += file.entry.size;
+        printf("  %s: %llu -> %llu%s\n", file.name.c_str(), (unsigned long long)file.entry.original_size,
+                (unsigned long long)file.entry.size, file.entry.compression == archive_lz4 ? " (lz4)" : "");
+    }
+    printf("Packed {%zu} files, {%zu} -> {%zu} bytes into {%s}\n", files.size(), original_total, packed_total, argv[3]);
+    return 0;
+}
@@ -0,0 +1,212 @@
+#ifndef PICKING_H
+#define PICKING_H
+
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "bounds.h"
+#include "bvh.h"
+#include "mesh.h"
+
+// Ray picking: scene bvh over object bounds first, then the triangles of each
+// candidate in object space. Triangles are packed four to a packet in
+// structure-of-arrays form for a 4-wide Moller-Trumbore test, and every mesh
+// gets its own bvh over packets so huge meshes only touch a few of them.
+
+struct triangle_packet {
+    float v0_x[4], v0_y[4], v0_z[4];
+    float e1_x[4], e1_y[4], e1_z[4];
+    float e2_x[4], e2_y[4], e2_z[4];
+    uint32_t triangle[4]; // index into the source index list / 3, padding is bvh_empty_slot
+};
+
+struct packed_mesh {
+    std::vector<triangle_packet> packets;
+    bvh4 tree; // over packet bounds
+};
+
+struct pick_hit {
+    uint32_t object;   // bvh_empty_slot when nothing was hit
+    uint32_t triangle; // bvh_empty_slot when the budget ran out before an exact test
+    float t;
+    glm::vec3 point;
+};
+
+// world space ray through a point given in normalized device coordinates
+inline ray pick_ray(glm::vec2 ndc, const glm::mat4& view, const glm::mat4& projection) {
+    auto inverse = glm::inverse(projection * view);
+    auto near_point = inverse * glm::vec4(ndc.x, ndc.y, -1.f, 1.f);
+    auto far_point = inverse * glm::vec4(ndc.x, ndc.y, 1.f, 1.f);
+    auto origin = glm::vec3(near_point) / near_point.w;
+    auto target = glm::vec3(far_point) / far_point.w;
+    return ray { origin, glm::normalize(target - origin) };
+}
+
+inline void pack_mesh(const mesh_data& mesh, packed_mesh& packed, thread_pool* pool = nullptr) {
+    packed.packets.clear();
+    auto triangle_count = mesh.triangle_count();
+
+    // a bvh over single triangles gives a spatially coherent order to pack in
+    std::vector<aabb> triangle_bounds(triangle_count);
+    for (uint32_t t = 0; t < triangle_count; t++) {
+        auto a = mesh.position(mesh.indices[t * 3]);
+        auto b = mesh.position(mesh.indices[t * 3 + 1]);
+        auto c = mesh.position(mesh.indices[t * 3 + 2]);
+        triangle_bounds[t] = aabb { glm::min(a, glm::min(b, c)), glm::max(a, glm::max(b, c)) };
+    }
+    bvh4 order;
+    order.build(triangle_bounds, pool);
+
+    std::vector<aabb> packet_bounds;
+    for (uint32_t first = 0; first < triangle_count; first += 4) {
+        triangle_packet packet;
+        auto box = aabb_empty();
+        for (int lane = 0; lane < 4; lane++) {
+            auto i = first + lane;
+            if (i >= triangle_count) {
+                // degenerate padding never passes the determinant test
+                packet.v0_x[lane] = packet.v0_y[lane] = packet.v0_z[lane] = 0.f;
+                packet.e1_x[lane] = packet.e1_y[lane] = packet.e1_z[lane] = 0.f;
+                packet.e2_x[lane] = packet.e2_y[lane] = packet.e2_z[lane] = 0.f;
+                packet.triangle[lane] = bvh_empty_slot;
+                continue;
+            }
+            auto t = order.items[i];
+            auto a = mesh.position(mesh.indices[t * 3]);
+            auto e1 = mesh.position(mesh.indices[t * 3 + 1]) - a;
+            auto e2 = mesh.position(mesh.indices[t * 3 + 2]) - a;
+            packet.v0_x[lane] = a.x; packet.v0_y[lane] = a.y; packet.v0_z[lane] = a.z;
+            packet.e1_x[lane] = e1.x; packet.e1_y[lane] = e1.y; packet.e1_z[lane] = e1.z;
+            packet.e2_x[lane] = e2.x; packet.e2_y[lane] = e2.y; packet.e2_z[lane] = e2.z;
+            packet.triangle[lane] = t;
+            box = aabb_union(box, triangle_bounds[t]);
+        }
+        packed.packets.push_back(packet);
+        packet_bounds.push_back(box);
+    }
+    packed.tree.build(packet_bounds, pool);
+}
+
+// Moller-Trumbore against four triangles at once; returns the lane of the
+// closest hit nearer than max_t, or -1
+inline int intersect_packet(const triangle_packet& p, const ray& r, float max_t, float& t_out) {
+    const float epsilon = 1e-8f;
+#ifdef BVH_SSE
+    auto dx = _mm_set1_ps(r.direction.x), dy = _mm_set1_ps(r.direction.y), dz = _mm_set1_ps(r.direction.z);
+    auto e1x = _mm_loadu_ps(p.e1_x), e1y = _mm_loadu_ps(p.e1_y), e1z = _mm_loadu_ps(p.e1_z);
+    auto e2x = _mm_loadu_ps(p.e2_x), e2y = _mm_loadu_ps(p.e2_y), e2z = _mm_loadu_ps(p.e2_z);
+
+    // p = d x e2
+    auto px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    auto py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    auto pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    auto det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    auto abs_det = _mm_andnot_ps(_mm_set1_ps(-0.f), det);
+    auto valid = _mm_cmpgt_ps(abs_det, _mm_set1_ps(epsilon));
+    auto inv_det = _mm_div_ps(_mm_set1_ps(1.f), det);
+
+    // s = o - v0
+    auto sx = _mm_sub_ps(_mm_set1_ps(r.origin.x), _mm_loadu_ps(p.v0_x));
+    auto sy = _mm_sub_ps(_mm_set1_ps(r.origin.y), _mm_loadu_ps(p.v0_y));
+    auto sz = _mm_sub_ps(_mm_set1_ps(r.origin.z), _mm_loadu_ps(p.v0_z));
+    auto u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inv_det);
+
+    // q = s x e1
+    auto qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    auto qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    auto qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    auto v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inv_det);
+    auto t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv_det);
+
+    auto zero = _mm_setzero_ps();
+    valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+    valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+    valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.f)));
+    valid = _mm_and_ps(valid, _mm_cmpgt_ps(t, _mm_set1_ps(epsilon)));
+    valid = _mm_and_ps(valid, _mm_cmplt_ps(t, _mm_set1_ps(max_t)));
+    auto mask = _mm_movemask_ps(valid);
+    if (!mask) return -1;
+
+    float ts[4];
+    _mm_storeu_ps(ts, t);
+#else
+    float ts[4];
+    int mask = 0;
+    for (int lane = 0; lane < 4; lane++) {
+        auto e1 = glm::vec3(p.e1_x[lane], p.e1_y[lane], p.e1_z[lane]);
+        auto e2 = glm::vec3(p.e2_x[lane], p.e2_y[lane], p.e2_z[lane]);
+        auto pv = glm::cross(r.direction, e2);
+        auto det = glm::dot(e1, pv);
+        if (det > -epsilon && det < epsilon) continue;
+        auto inv_det = 1.f / det;
+        auto s = r.origin - glm::vec3(p.v0_x[lane], p.v0_y[lane], p.v0_z[lane]);
+        auto u = glm::dot(s, pv) * inv_det;
+        auto q = glm::cross(s, e1);
+        auto v = glm::dot(r.direction, q) * inv_det;
+        ts[lane] = glm::dot(e2, q) * inv_det;
+        if (u < 0.f || v < 0.f || u + v > 1.f || ts[lane] <= epsilon || ts[lane] >= max_t) continue;
+        mask |= 1 << lane;
+    }
+    if (!mask) return -1;
+#endif
+    int best = -1;
+    for (int lane = 0; lane < 4; lane++) {
+        if ((mask & (1 << lane)) && (best < 0 || ts[lane] < ts[best])) best = lane;
+    }
+    t_out = ts[best];
+    return best;
+}
+
+// Closest hit against the objects in `scene`. mesh_of(object) returns the
+// packed_mesh for an object and model_of(object) its model matrix. At most
+// packet_budget packets are tested exactly; past that, candidates fall back
+// to their bounds so a pick never stalls on a pathological view.
+template <class MeshFn, class ModelFn>
+pick_hit pick(const bvh4& scene, const ray& world_ray, float max_t, unsigned int packet_budget,
+        MeshFn&& mesh_of, ModelFn&& model_of) {
+    pick_hit result { bvh_empty_slot, bvh_empty_slot, max_t, glm::vec3(0.f) };
+    unsigned int packets_tested = 0;
+
+    auto hit = scene.query_ray(world_ray, max_t, [&](uint32_t object, const ray& r, float best_t) -> float {
+        auto bounds_t = ray_aabb(r, scene.bounds[object], best_t);
+        if (bounds_t < 0.f) return -1.f;
+        const packed_mesh* mesh = mesh_of(object);
+        if (!mesh) return bounds_t;
+
+        // an affine inverse keeps the ray parameter, so t stays in world units
+        auto to_object = glm::inverse(model_of(object));
+        ray local { glm::vec3(to_object * glm::vec4(r.origin, 1.f)),
+            glm::vec3(to_object * glm::vec4(r.direction, 0.f)) };
+
+        uint32_t triangle = bvh_empty_slot;
+        auto local_hit = mesh->tree.query_ray(local, best_t, [&](uint32_t packet, const ray& lr, float t_max) -> float {
+            if (packets_tested >= packet_budget) {
+                // a bounds hit is no triangle, so when it wins it mustn't keep an
+                // earlier one; query_ray only takes hits nearer than t_max
+                auto packet_t = ray_aabb(lr, mesh->tree.bounds[packet], t_max);
+                if (packet_t >= 0.f && packet_t < t_max) triangle = bvh_empty_slot;
+                return packet_t;
+            }
+            packets_tested++;
+            float t;
+            auto lane = intersect_packet(mesh->packets[packet], lr, t_max, t);
+            if (lane < 0) return -1.f;
+            triangle = mesh->packets[packet].triangle[lane];
+            return t;
+        });
+        if (local_hit.item == bvh_empty_slot) return -1.f;
+        if (local_hit.t < result.t) {
+            result.object = object;
+            result.triangle = triangle;
+            result.t = local_hit.t;
+        }
+        return local_hit.t;
+    });
+
+    if (hit.item == bvh_empty_slot) return pick_hit { bvh_empty_slot, bvh_empty_slot, max_t, glm::vec3(0.f) };
+    result.point = world_ray.origin + result.t * world_ray.direction;
+    return result;
+}
+
+#endif
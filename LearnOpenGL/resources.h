@@ -0,0 +1,421 @@
+#ifndef RESOURCES_H
+#define RESOURCES_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "archive.h"
+#include "assrt.h"
+#include "mesh.h"
+#include "shader.h"
+
+// GL objects behind generational handles.
+//
+// Every kind of resource lives in a resource_pool: a slot vector with a free
+// list, so lookups are an index and a generation compare. Releasing the last
+// reference bumps the slot's generation, which turns every handle still
+// pointing at it stale instead of dangling. Loads can be keyed by a path or
+// content hash, and asking for the same key again shares the resource.
+// GL names are not deleted when released but retired behind a fence, and
+// only deleted once the GPU has finished every frame that could use them.
+// Programs remember their source paths and are rebuilt in place when the
+// files change, so handles held across a reload stay valid.
+
+template <typename T>
+struct handle {
+    uint32_t index = 0;
+    uint32_t generation = 0; // never issued, so a default handle is null
+
+    explicit operator bool() const { return generation != 0; }
+    bool operator==(const handle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const handle& other) const { return !(*this == other); }
+};
+
+enum class resource_state { loading, ready, failed };
+
+// FNV-1a, for deduplicating by path or contents
+inline uint64_t resource_key(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    auto bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline uint64_t resource_key(const std::string& text, uint64_t hash = 14695981039346656037ull) {
+    return resource_key(text.data(), text.size(), hash);
+}
+
+template <typename T>
+class resource_pool {
+    private:
+        struct slot {
+            T value {};
+            uint32_t generation = 1;
+            uint32_t refs = 0;
+            resource_state state = resource_state::loading;
+            uint64_t key = 0; // 0 for resources that aren't shared
+        };
+
+        std::vector<slot> slots;
+        std::vector<uint32_t> free_slots;
+        std::unordered_map<uint64_t, uint32_t> by_key;
+
+        slot* lookup(handle<T> h) {
+            if (h.index >= slots.size() || slots[h.index].generation != h.generation || !slots[h.index].refs) return nullptr;
+            return &slots[h.index];
+        }
+        const slot* lookup(handle<T> h) const {
+            return const_cast<resource_pool*>(this)->lookup(h);
+        }
+
+    public:
+        // a new reference to the resource loaded under key, or a null handle
+        handle<T> find(uint64_t key) {
+            auto found = by_key.find(key);
+            if (!key || found == by_key.end()) return handle<T> {};
+            auto& s = slots[found->second];
+            s.refs++;
+            return handle<T> { found->second, s.generation };
+        }
+
+        handle<T> insert(const T& value, uint64_t key = 0, resource_state state = resource_state::ready) {
+            uint32_t index;
+            if (!free_slots.empty()) {
+                index = free_slots.back();
+                free_slots.pop_back();
+            } else {
+                index = slots.size();
+                slots.emplace_back();
+            }
+            auto& s = slots[index];
+            s.value = value;
+            s.refs = 1;
+            s.state = state;
+            s.key = key;
+            if (key) by_key[key] = index;
+            return handle<T> { index, s.generation };
+        }
+
+        // null while stale, loading or failed
+        const T* get(handle<T> h) const {
+            auto s = lookup(h);
+            return s && s->state == resource_state::ready ? &s->value : nullptr;
+        }
+
+        resource_state state(handle<T> h) const {
+            auto s = lookup(h);
+            return s ? s->state : resource_state::failed;
+        }
+
+        // Finishes a load or swaps the contents of a live resource; returns
+        // the previous value so the caller can retire it.
+        T replace(handle<T> h, const T& value, resource_state state = resource_state::ready) {
+            auto s = lookup(h);
+            assrt(s, "Replacing a stale resource handle {%u}", h.index);
+            if (!s) return T {};
+            auto old = s->value;
+            s->value = value;
+            s->state = state;
+            return old;
+        }
+
+        void retain(handle<T> h) {
+            if (auto s = lookup(h)) s->refs++;
+        }
+
+        // true when that was the last reference; out then holds the value to retire
+        bool release(handle<T> h, T& out) {
+            auto s = lookup(h);
+            if (!s || --s->refs) return false;
+            out = s->value;
+            if (s->key) by_key.erase(s->key);
+            s->value = T {};
+            s->key = 0;
+            // wrap past 0 so the null generation is never issued
+            if (++s->generation == 0) s->generation = 1;
+            free_slots.push_back(h.index);
+            return true;
+        }
+
+        template <typename F>
+        void for_each(F&& fn) {
+            for (uint32_t i = 0; i < slots.size(); i++) {
+                if (slots[i].refs) fn(handle<T> { i, slots[i].generation }, slots[i].value);
+            }
+        }
+
+        size_t size() const { return slots.size() - free_slots.size(); }
+};
+
+struct gpu_buffer {
+    GLuint name;
+    GLenum target;
+    size_t size;
+};
+
+struct gpu_texture {
+    GLuint name;
+    GLenum target;
+};
+
+struct gpu_program {
+    GLuint name;
+    std::string vert_path;
+    std::string frag_path;
+    std::string header; // see Shader::configure
+    std::filesystem::file_time_type vert_time;
+    std::filesystem::file_time_type frag_time;
+};
+
+// vertex array over an interleaved mesh_data layout, with its own buffers
+struct gpu_mesh {
+    GLuint vao;
+    GLuint vbo;
+    GLuint ebo;
+    unsigned int index_count;
+    size_t bytes; // vbo and ebo together
+};
+
+typedef handle<gpu_buffer> buffer_handle;
+typedef handle<gpu_texture> texture_handle;
+typedef handle<gpu_program> program_handle;
+typedef handle<gpu_mesh> mesh_handle;
+
+class resource_manager {
+    private:
+        struct retired_batch {
+            GLsync fence;
+            std::vector<std::function<void()>> destroy;
+        };
+
+        resource_pool<gpu_buffer> buffers;
+        resource_pool<gpu_texture> textures;
+        resource_pool<gpu_program> programs;
+        resource_pool<gpu_mesh> meshes;
+
+        std::vector<std::function<void()>> retiring; // released this frame, not fenced yet
+        std::deque<retired_batch> retired;
+
+        static std::filesystem::file_time_type modified(const std::string& path) {
+            std::error_code error;
+            auto time = std::filesystem::last_write_time(path, error);
+            return error ? std::filesystem::file_time_type() : time;
+        }
+
+        const asset_vfs* files = nullptr;
+
+        // loose_only reads the files on disk even when an archive has them,
+        // which is where edits being hot reloaded end up
+        GLuint compile(const gpu_program& program, bool loose_only = false) const {
+            Shader shader;
+            auto header = program.header.empty() ? nullptr : program.header.c_str();
+            if (files) {
+                shader.configure_source(files->read_text(program.vert_path.c_str(), loose_only),
+                        files->read_text(program.frag_path.c_str(), loose_only), header);
+            } else {
+                shader.configure(program.vert_path.c_str(), program.frag_path.c_str(), header);
+            }
+            return shader.ID;
+        }
+
+        void retire(std::function<void()> destroy) {
+            retiring.push_back(std::move(destroy));
+        }
+
+        void retire(const gpu_buffer& buffer) {
+            auto name = buffer.name;
+            if (name) retire([name] { glDeleteBuffers(1, &name); });
+        }
+        void retire(const gpu_texture& texture) {
+            auto name = texture.name;
+            if (name) retire([name] { glDeleteTextures(1, &name); });
+        }
+        void retire(const gpu_program& program) {
+            auto name = program.name;
+            if (name) retire([name] { glDeleteProgram(name); });
+        }
+        void retire(const gpu_mesh& mesh) {
+            auto m = mesh;
+            if (!m.vao) return;
+            retire([m] {
+                glDeleteVertexArrays(1, &m.vao);
+                glDeleteBuffers(1, &m.vbo);
+                glDeleteBuffers(1, &m.ebo);
+            });
+        }
+
+    public:
+        // where programs are read from; null reads loose files directly
+        void set_files(const asset_vfs* vfs) { files = vfs; }
+
+        buffer_handle create_buffer(GLenum target, size_t size, const void* data, GLenum usage, uint64_t key = 0) {
+            if (auto shared = buffers.find(key)) return shared;
+            gpu_buffer buffer { 0, target, size };
+            glGenBuffers(1, &buffer.name);
+            glBindBuffer(target, buffer.name);
+            glBufferData(target, size, data, usage);
+            return buffers.insert(buffer, key);
+        }
+
+        // takes ownership of a texture created elsewhere
+        texture_handle adopt_texture(GLuint name, GLenum target, uint64_t key = 0) {
+            if (auto shared = textures.find(key)) return shared;
+            return textures.insert(gpu_texture { name, target }, key);
+        }
+
+        // Compiles and links, or shares an already loaded program built from
+        // the same sources and header. Failure leaves the handle failed.
+        program_handle load_program(const char* vert_path, const char* frag_path, const char* header = nullptr) {
+            auto key = resource_key(vert_path);
+            key = resource_key(frag_path, key);
+            key = resource_key(header ? header : "", key);
+            if (auto shared = programs.find(key)) return shared;
+
+            gpu_program program { 0, vert_path, frag_path, header ? header : "",
+                modified(vert_path), modified(frag_path) };
+            program.name = compile(program);
+            return programs.insert(program, key, program.name ? resource_state::ready : resource_state::failed);
+        }
+
+        // vao, vbo and ebo for vertices laid out as in mesh_data; indices can
+        // come from elsewhere, e.g. a lod chain over the same vertices
+        mesh_handle create_mesh(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+                uint64_t key = 0) {
+            if (auto shared = meshes.find(key)) return shared;
+            gpu_mesh mesh { 0, 0, 0, (unsigned int)indices.size(),
+                    indices.size() * sizeof(unsigned int) + vertices.size() * sizeof(float) };
+            glGenVertexArrays(1, &mesh.vao);
+            glBindVertexArray(mesh.vao);
+
+            glGenBuffers(1, &mesh.ebo);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+            glGenBuffers(1, &mesh.vbo);
+            glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+
+            // position, color, texture coordinates
+            auto stride = mesh_vertex_stride * sizeof(float);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
+            glEnableVertexAttribArray(2);
+            return meshes.insert(mesh, key);
+        }
+
+        // for loads finished later, e.g. on another thread: reserve the handle
+        // now, then finish_texture() or fail_texture() on the GL thread
+        texture_handle begin_texture(uint64_t key = 0) {
+            if (auto shared = textures.find(key)) return shared;
+            return textures.insert(gpu_texture { 0, 0 }, key, resource_state::loading);
+        }
+        void finish_texture(texture_handle h, GLuint name, GLenum target) {
+            retire(textures.replace(h, gpu_texture { name, target }));
+        }
+        void fail_texture(texture_handle h) {
+            retire(textures.replace(h, gpu_texture { 0, 0 }, resource_state::failed));
+        }
+
+        const gpu_buffer* get(buffer_handle h) const { return buffers.get(h); }
+        const gpu_texture* get(texture_handle h) const { return textures.get(h); }
+        const gpu_program* get(program_handle h) const { return programs.get(h); }
+        const gpu_mesh* get(mesh_handle h) const { return meshes.get(h); }
+
+        resource_state state(texture_handle h) const { return textures.state(h); }
+        resource_state state(program_handle h) const { return programs.state(h); }
+
+        void retain(buffer_handle h) { buffers.retain(h); }
+        void retain(texture_handle h) { textures.retain(h); }
+        void retain(program_handle h) { programs.retain(h); }
+        void retain(mesh_handle h) { meshes.retain(h); }
+
+        void release(buffer_handle h) { gpu_buffer old; if (buffers.release(h, old)) retire(old); }
+        void release(texture_handle h) { gpu_texture old; if (textures.release(h, old)) retire(old); }
+        void release(program_handle h) { gpu_program old; if (programs.release(h, old)) retire(old); }
+        void release(mesh_handle h) { gpu_mesh old; if (meshes.release(h, old)) retire(old); }
+
+        // Rebuilds programs whose source files changed since they were built.
+        // A program that no longer compiles keeps running the old one.
+        // Returns how many were swapped.
+        unsigned int reload_changed_programs() {
+            unsigned int swapped = 0;
+            programs.for_each([&](program_handle h, gpu_program& program) {
+                auto vert_time = modified(program.vert_path), frag_time = modified(program.frag_path);
+                if (vert_time == program.vert_time && frag_time == program.frag_time) return;
+                auto rebuilt = program;
+                rebuilt.vert_time = vert_time;
+                rebuilt.frag_time = frag_time;
+                rebuilt.name = compile(rebuilt, true);
+                if (!rebuilt.name) {
+                    // don't retry until the files change again
+                    program.vert_time = vert_time;
+                    program.frag_time = frag_time;
+                    return;
+                }
+                retire(programs.replace(h, rebuilt));
+                swapped++;
+            });
+            return swapped;
+        }
+
+        // Call once per frame after the last draw. Fences what was released
+        // this frame and deletes batches the GPU is done with.
+        void end_frame() {
+            if (!retiring.empty()) {
+                retired.push_back(retired_batch { glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), std::move(retiring) });
+                retiring.clear();
+            }
+            while (!retired.empty()) {
+                auto status = glClientWaitSync(retired.front().fence, 0, 0);
+                if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+                for (auto& destroy : retired.front().destroy) destroy();
+                glDeleteSync(retired.front().fence);
+                retired.pop_front();
+            }
+        }
+
+        size_t size() const { return buffers.size() + textures.size() + programs.size() + meshes.size(); }
+
+        // buffer memory allocated through the manager, mesh buffers included
+        size_t buffer_bytes() {
+            size_t bytes = 0;
+            buffers.for_each([&](buffer_handle, gpu_buffer& b) { bytes += b.size; });
+            meshes.for_each([&](mesh_handle, gpu_mesh& m) { bytes += m.bytes; });
+            return bytes;
+        }
+
+        // deletes everything right away; call while the context is still current
+        void release_all() {
+            glFinish();
+            buffers.for_each([&](buffer_handle, gpu_buffer& b) { retire(b); });
+            textures.for_each([&](texture_handle, gpu_texture& t) { retire(t); });
+            programs.for_each([&](program_handle, gpu_program& p) { retire(p); });
+            meshes.for_each([&](mesh_handle, gpu_mesh& m) { retire(m); });
+            buffers = resource_pool<gpu_buffer>();
+            textures = resource_pool<gpu_texture>();
+            programs = resource_pool<gpu_program>();
+            meshes = resource_pool<gpu_mesh>();
+            for (auto& batch : retired) {
+                for (auto& destroy : batch.destroy) destroy();
+                glDeleteSync(batch.fence);
+            }
+            retired.clear();
+            for (auto& destroy : retiring) destroy();
+            retiring.clear();
+        }
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+
+// Sampling state lives in GL sampler objects instead of on textures, so
+// changing how something is filtered never touches texture objects, and any
+// number of textures share the few distinct samplers a scene really uses.
+//
+// sampler_desc is plain data that is hashed and compared bytewise; the cache
+// creates one sampler object per distinct description.
+
+struct sampler_desc {
+    GLenum min_filter = GL_LINEAR_MIPMAP_LINEAR;
+    GLenum mag_filter = GL_LINEAR;
+    GLenum wrap_s = GL_REPEAT;
+    GLenum wrap_t = GL_REPEAT;
+    GLenum wrap_r = GL_REPEAT;
+    float max_anisotropy = 1.f; // ignored without GL 4.6
+    float lod_bias = 0.f;
+    float min_lod = -1000.f;
+    float max_lod = 1000.f;
+
+    bool operator==(const sampler_desc& other) const {
+        return memcmp(this, &other, sizeof(sampler_desc)) == 0;
+    }
+};
+
+static_assert(sizeof(sampler_desc) == 5 * sizeof(GLenum) + 4 * sizeof(float), "sampler_desc is hashed bytewise");
+
+struct sampler_desc_hash {
+    // FNV-1a over the bytes; the struct has no padding
+    size_t operator()(const sampler_desc& desc) const {
+        auto bytes = (const unsigned char*)&desc;
+        size_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < sizeof(sampler_desc); i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+};
+
+// edge clamped trilinear, for textures that shouldn't tile
+inline sampler_desc clamped_sampler() {
+    sampler_desc desc;
+    desc.wrap_s = desc.wrap_t = desc.wrap_r = GL_CLAMP_TO_EDGE;
+    return desc;
+}
+
+class sampler_cache {
+    private:
+        std::unordered_map<sampler_desc, GLuint, sampler_desc_hash> samplers;
+
+        static GLuint create(const sampler_desc& desc) {
+            GLuint sampler;
+            glGenSamplers(1, &sampler);
+            glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, desc.min_filter);
+            glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, desc.mag_filter);
+            glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, desc.wrap_s);
+            glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, desc.wrap_t);
+            glSamplerParameteri(sampler, GL_TEXTURE_WRAP_R, desc.wrap_r);
+            glSamplerParameterf(sampler, GL_TEXTURE_LOD_BIAS, desc.lod_bias);
+            glSamplerParameterf(sampler, GL_TEXTURE_MIN_LOD, desc.min_lod);
+            glSamplerParameterf(sampler, GL_TEXTURE_MAX_LOD, desc.max_lod);
+            if (GLAD_GL_VERSION_4_6 && desc.max_anisotropy > 1.f) {
+                glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY, desc.max_anisotropy);
+            }
+            return sampler;
+        }
+
+    public:
+        // the sampler object for desc, created on first use
+        GLuint get(const sampler_desc& desc) {
+            auto found = samplers.find(desc);
+            if (found != samplers.end()) return found->second;
+            auto sampler = create(desc);
+            samplers.emplace(desc, sampler);
+            return sampler;
+        }
+
+        void bind(GLuint unit, const sampler_desc& desc) {
+            glBindSampler(unit, get(desc));
+        }
+
+        size_t size() const { return samplers.size(); }
+
+        // call while the context is still current
+        void release() {
+            for (auto& entry : samplers) glDeleteSamplers(1, &entry.second);
+            samplers.clear();
+        }
+};
+
+#endif
@@ -50,7 +50,9 @@ class Shader {
        
         Shader() {} 
 
-        void configure(const char* vert_path, const char* frag_path) {
+        // header replaces the #version line of both stages, e.g. to raise the
+        // version and add defines for an optional path
+        void configure(const char* vert_path, const char* frag_path, const char* header = nullptr) {
             std::string vert_code;
             std::string frag_code;
             std::ifstream v_shader_file;
@@ -75,6 +77,15 @@ class Shader {
             } catch (std::ifstream::failure e) {
                 printf("[Shader] Error: failed to read shader files.\n");
             }
+            configure_source(vert_code, frag_code, header);
+        }
+
+        // same as configure(), with the sources already in memory
+        void configure_source(std::string vert_code, std::string frag_code, const char* header = nullptr) {
+            if (header) {
+                vert_code = header + vert_code.substr(vert_code.find('\n') + 1);
+                frag_code = header + frag_code.substr(frag_code.find('\n') + 1);
+            }
             const char* v_shader_code = vert_code.c_str();
             const char* f_shader_code = frag_code.c_str();
 
@@ -100,9 +111,15 @@ class Shader {
         void seti(const std::string &name, int value) const {
             glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
         }
+        void set_block_binding(const std::string &name, GLuint binding) const {
+            glUniformBlockBinding(ID, glGetUniformBlockIndex(ID, name.c_str()), binding);
+        }
         void setf(const std::string &name, float value) const {
             glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
         }
+        void setvec4(const std::string &name, glm::vec4 value) const {
+            glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+        }
         void setmat4(const std::string &name, glm::mat4 matrix) const {
             glUniformMatrix4fv(
                     glGetUniformLocation(ID, name.c_str()),
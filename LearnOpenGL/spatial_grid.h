@@ -0,0 +1,223 @@
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "bounds.h"
+
+// Loose uniform grid for objects that move every frame.
+//
+// Objects are bucketed by their center only, so moving one is a cell lookup
+// and, when it crosses a cell border, two counter updates. Each cell's bounds
+// are treated as loose by the largest object half extent seen, which keeps
+// queries conservative without ever re-bucketing by size.
+// Cells live in one dense array addressed through an open addressing hash on
+// the integer cell coordinate, so only occupied space costs memory. Members
+// of all cells share one array, each cell owning the range at its offset;
+// the first query after a change regroups it with a counting sort, which
+// reuses its storage, so frames with a stable object count don't allocate.
+// Cells left empty are kept for objects coming back, until they outnumber
+// the occupied ones.
+
+class loose_grid {
+    public:
+        static constexpr uint32_t invalid = 0xffffffffu;
+
+        struct cell {
+            glm::ivec3 coord;
+            uint32_t offset; // into the member array, valid after a query
+            uint32_t count;
+        };
+
+    private:
+        float cell_size;
+        float max_extent = 0.f;
+        std::vector<cell> cells;
+        std::vector<uint32_t> table; // cell index per hash slot, invalid when free
+        std::vector<uint32_t> objects; // cell per object id, invalid when not inserted
+        std::vector<uint32_t> members; // object ids grouped by cell
+        std::vector<uint32_t> remap; // compact() only
+        uint32_t empty_cells = 0;
+        bool dirty = false; // members no longer match objects
+
+        static uint32_t hash(glm::ivec3 c) {
+            return (uint32_t)c.x * 73856093u ^ (uint32_t)c.y * 19349663u ^ (uint32_t)c.z * 83492791u;
+        }
+
+        void rehash(size_t size) {
+            table.assign(size, invalid);
+            auto mask = (uint32_t)table.size() - 1;
+            for (uint32_t i = 0; i < cells.size(); i++) {
+                auto h = hash(cells[i].coord) & mask;
+                while (table[h] != invalid) h = (h + 1) & mask;
+                table[h] = i;
+            }
+        }
+
+        uint32_t find_cell(glm::ivec3 coord) const {
+            if (table.empty()) return invalid;
+            auto mask = (uint32_t)table.size() - 1;
+            auto h = hash(coord) & mask;
+            while (table[h] != invalid && !(cells[table[h]].coord == coord)) h = (h + 1) & mask;
+            return table[h];
+        }
+
+        uint32_t find_or_add_cell(glm::ivec3 coord) {
+            auto found = find_cell(coord);
+            if (found != invalid) return found;
+            if ((cells.size() + 1) * 2 > table.size()) rehash(table.empty() ? 64 : table.size() * 2);
+            auto mask = (uint32_t)table.size() - 1;
+            auto h = hash(coord) & mask;
+            while (table[h] != invalid) h = (h + 1) & mask;
+            table[h] = cells.size();
+            cells.push_back(cell { coord, 0, 0 });
+            empty_cells++;
+            return table[h];
+        }
+
+        void unlink(uint32_t id) {
+            auto& c = cells[objects[id]];
+            if (--c.count == 0) empty_cells++;
+            objects[id] = invalid;
+            dirty = true;
+        }
+
+        void link(uint32_t id, uint32_t cell_index) {
+            auto& c = cells[cell_index];
+            if (c.count++ == 0) empty_cells--;
+            objects[id] = cell_index;
+            dirty = true;
+        }
+
+        // counting sort of the ids by cell into members
+        void update_members() {
+            if (!dirty) return;
+            if (empty_cells > 64 && empty_cells > cells.size() - empty_cells) compact();
+            dirty = false;
+            uint32_t offset = 0;
+            for (auto& c : cells) {
+                c.offset = offset;
+                offset += c.count;
+            }
+            members.resize(offset);
+            for (uint32_t id = 0; id < objects.size(); id++) {
+                if (objects[id] != invalid) members[cells[objects[id]].offset++] = id;
+            }
+            for (auto& c : cells) c.offset -= c.count;
+        }
+
+        // calls visit(cell index) for occupied cells whose loose bounds may overlap box
+        template <class F>
+        void for_each_cell(const aabb& box, F&& visit) {
+            update_members();
+            auto lo_position = box.min - glm::vec3(max_extent);
+            auto hi_position = box.max + glm::vec3(max_extent);
+            // in floats, so huge or infinite boxes can't overflow the cell coordinates
+            auto across = (hi_position - lo_position) / cell_size + glm::vec3(1.f);
+            auto span = across.x * across.y * across.z;
+            // large boxes are cheaper to answer by walking the occupied cells
+            if (!(span <= (float)(cells.size() - empty_cells))) {
+                for (uint32_t i = 0; i < cells.size(); i++) {
+                    if (cells[i].count && aabb_overlap(cell_bounds(cells[i]), box)) visit(i);
+                }
+                return;
+            }
+            auto lo = cell_coord(lo_position);
+            auto hi = cell_coord(hi_position);
+            for (int z = lo.z; z <= hi.z; z++) {
+                for (int y = lo.y; y <= hi.y; y++) {
+                    for (int x = lo.x; x <= hi.x; x++) {
+                        auto i = find_cell(glm::ivec3(x, y, z));
+                        if (i != invalid && cells[i].count) visit(i);
+                    }
+                }
+            }
+        }
+
+        void append_members(const cell& c, std::vector<uint32_t>& out) const {
+            out.insert(out.end(), members.begin() + c.offset, members.begin() + c.offset + c.count);
+        }
+
+    public:
+        explicit loose_grid(float cell_size = 4.f) : cell_size(cell_size) {}
+
+        glm::ivec3 cell_coord(glm::vec3 position) const {
+            return glm::ivec3((int)std::floor(position.x / cell_size),
+                    (int)std::floor(position.y / cell_size),
+                    (int)std::floor(position.z / cell_size));
+        }
+
+        // loose bounds: everything bucketed here lies within them
+        aabb cell_bounds(const cell& c) const {
+            auto lo = glm::vec3(c.coord.x, c.coord.y, c.coord.z) * cell_size;
+            return aabb { lo - glm::vec3(max_extent), lo + glm::vec3(cell_size + max_extent) };
+        }
+
+        const std::vector<cell>& get_cells() const { return cells; }
+
+        // the ids bucketed in a cell from get_cells(), as of the last query
+        const uint32_t* cell_members(const cell& c) const { return members.data() + c.offset; }
+
+        // ids are caller chosen and should be dense, like indices into a scene array
+        void insert(uint32_t id, glm::vec3 center, float half_extent) {
+            if (id >= objects.size()) objects.resize(id + 1, invalid);
+            if (objects[id] != invalid) unlink(id);
+            max_extent = glm::max(max_extent, half_extent);
+            link(id, find_or_add_cell(cell_coord(center)));
+        }
+
+        // ignores ids that aren't inserted
+        void move(uint32_t id, glm::vec3 center) {
+            if (id >= objects.size() || objects[id] == invalid) return;
+            auto coord = cell_coord(center);
+            if (cells[objects[id]].coord == coord) return;
+            unlink(id);
+            link(id, find_or_add_cell(coord));
+        }
+
+        void remove(uint32_t id) {
+            if (id < objects.size() && objects[id] != invalid) unlink(id);
+        }
+
+        // appends indices into get_cells() for occupied cells touching the frustum
+        void visible_cells(const frustum& f, std::vector<uint32_t>& out) {
+            for_each_cell(frustum_bounds(f), [&](uint32_t i) {
+                if (frustum_test(f, cell_bounds(cells[i])) != cull_result::outside) out.push_back(i);
+            });
+        }
+
+        void query_frustum(const frustum& f, std::vector<uint32_t>& out) {
+            for_each_cell(frustum_bounds(f), [&](uint32_t i) {
+                if (frustum_test(f, cell_bounds(cells[i])) != cull_result::outside) append_members(cells[i], out);
+            });
+        }
+
+        void query_aabb(const aabb& box, std::vector<uint32_t>& out) {
+            for_each_cell(box, [&](uint32_t i) { append_members(cells[i], out); });
+        }
+
+        // drops empty cells left behind by moving objects; the first query
+        // after enough of them have piled up does this on its own
+        void compact() {
+            remap.resize(cells.size());
+            uint32_t kept = 0;
+            for (uint32_t i = 0; i < cells.size(); i++) {
+                remap[i] = cells[i].count ? kept : invalid;
+                if (cells[i].count) cells[kept++] = cells[i];
+            }
+            cells.resize(kept);
+            for (auto& c : objects) {
+                if (c != invalid) c = remap[c];
+            }
+            empty_cells = 0;
+            dirty = true;
+            size_t size = 64;
+            while (cells.size() * 2 > size) size *= 2;
+            rehash(size);
+        }
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue for exactly one producer and one consumer thread.
+//
+// Head and tail only ever increase and are masked into the array, so full
+// and empty are told apart without a spare slot. Each index is written by
+// one side only and lives on its own cache line, so the two threads don't
+// bounce a line between them on every push and pop.
+
+template <typename T, size_t Capacity>
+class spsc_ring {
+    static_assert(Capacity && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+    private:
+        static constexpr size_t mask = Capacity - 1;
+
+        T items[Capacity];
+        alignas(64) std::atomic<size_t> head { 0 }; // next to pop, written by the consumer
+        alignas(64) std::atomic<size_t> tail { 0 }; // next to push, written by the producer
+
+    public:
+        // producer only; false when full, the item is then dropped
+        bool push(const T& item) {
+            auto t = tail.load(std::memory_order_relaxed);
+            if (t - head.load(std::memory_order_acquire) == Capacity) return false;
+            items[t & mask] = item;
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        // consumer only; false when empty
+        bool pop(T& item) {
+            auto h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire)) return false;
+            item = items[h & mask];
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        // approximate unless called from one of the two sides
+        size_t size() const {
+            return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+        }
+
+        static constexpr size_t capacity() { return Capacity; }
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef STAGING_BUFFER_H
+#define STAGING_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// Pixel unpack buffer that texture data is written into directly, so the
+// driver never has to copy it out of client memory.
+//
+// With GL 4.4 the storage is immutable and mapped persistently once; writes
+// can then happen from any thread while the GL thread only binds it. Older
+// contexts map and unmap around every batch. Either way the buffer is kept
+// and only grows, and a fence stops the next map from overwriting data the
+// GPU has not consumed yet.
+class staging_buffer {
+    private:
+        GLuint buffer = 0;
+        size_t capacity = 0;
+        unsigned char* mapped = nullptr;
+        bool persistent = false;
+        GLsync fence = 0;
+
+        void wait_for_gpu() {
+            if (!fence) return;
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+            glDeleteSync(fence);
+            fence = 0;
+        }
+
+        void allocate(size_t size) {
+            release();
+            // round up so a series of slightly larger batches doesn't reallocate every time
+            capacity = 1 << 20;
+            while (capacity < size) capacity *= 2;
+            persistent = GLAD_GL_VERSION_4_4;
+
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+            if (persistent) {
+                auto flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                glBufferStorage(GL_PIXEL_UNPACK_BUFFER, capacity, nullptr, flags);
+                mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, capacity, flags);
+            } else {
+                glBufferData(GL_PIXEL_UNPACK_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+
+    public:
+        // Returns writable memory for at least size bytes. GL thread only, but
+        // the memory itself can be filled from any thread until bind().
+        unsigned char* map(size_t size) {
+            wait_for_gpu();
+            if (size > capacity) allocate(size);
+            if (persistent) return mapped;
+
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+            mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return mapped;
+        }
+
+        // leaves the buffer bound to GL_PIXEL_UNPACK_BUFFER; texture uploads
+        // then take byte offsets into it instead of pointers
+        void bind() {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+            if (!persistent) {
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                mapped = nullptr;
+            }
+        }
+
+        // call once the uploads reading from the buffer have been issued
+        void unbind() {
+            if (persistent) fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+
+        size_t size() const { return capacity; }
+
+        // call while the context is still current
+        void release() {
+            wait_for_gpu();
+            if (buffer) {
+                if (persistent && mapped) {
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+                    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                }
+                glDeleteBuffers(1, &buffer);
+            }
+            buffer = 0;
+            capacity = 0;
+            mapped = nullptr;
+        }
+};
+
+#endif
@@ -0,0 +1,486 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "archive.h"
+#include "assrt.h"
+#include "glm/glm.hpp"
+#include "mapped_file.h"
+#include "mipmap.h"
+#include "sampler.h"
+#include "stb_image/stb_image.h"
+#include "staging_buffer.h"
+#include "thread_pool.h"
+
+// Packs every loaded image into a handful of GL_TEXTURE_2D_ARRAYs so that
+// materials differ only in a layer index and a uv rect, never in a binding.
+//
+// Power-of-two images are grouped by size, one layer each. Anything else is
+// shelf packed into atlas pages, which are themselves layers of the
+// atlas_page_size array, and sampled through uv * rect.zw + rect.xy.
+// Everything is stored as RGBA8 so grouping only has to look at size.
+// Images are decoded and mipmapped on the pool in upload(), and every level
+// is uploaded explicitly instead of relying on glGenerateMipmap.
+// Files are views into the mapped asset archive, or mapped loose files, and
+// are decoded in place; the chains are built directly in a mapped pixel
+// unpack buffer, so the only texel copy between disk and driver is out of
+// stb_image's decode buffer.
+// Sources are remembered after loading, so finer levels can be dropped with
+// drop_levels() and decoded again later with restore_levels(), or in the
+// background with stream_levels(). Only levels below GL_TEXTURE_BASE_LEVEL
+// ever change, so sampling never sees a level that is being replaced.
+// Loading only the tail doesn't make startup cheaper on the CPU: stb_image
+// can't decode at a reduced size and the tail is filtered down from level 0,
+// so every image is still fully decoded and filtered once at startup, and
+// again when its finer levels are streamed in. What the tail saves is
+// staging, upload bandwidth and video memory.
+
+struct texture_load_stats {
+    size_t file_bytes;    // mapped from disk
+    size_t decoded_bytes; // level 0 texels produced by the decoder
+    size_t copied_bytes;  // texels copied after decoding, into staging or atlas pages
+    size_t staged_bytes;  // written to pixel unpack buffers, every level
+    size_t peak_rss;      // process high-water mark after the load
+    double milliseconds;
+};
+
+struct texture_layer {
+    unsigned int array; // index into texture_arrays::get_arrays()
+    unsigned int layer;
+    glm::vec4 uv_rect;  // offset in xy, scale in zw; (0, 0, 1, 1) for whole layers
+};
+
+class texture_arrays {
+    public:
+        static constexpr int atlas_page_size = 1024;
+        // gap around atlas entries so the first few mips don't bleed into neighbours
+        static constexpr int atlas_padding = 4;
+        static constexpr unsigned int invalid = 0xffffffffu;
+        // levels at or below this many texels on a side are loaded up front and always kept
+        static constexpr int tail_size = 64;
+
+        struct array_info {
+            GLuint texture;
+            int width;
+            int height;
+            unsigned int layer_count;
+            int level_count;
+            int base_level; // finest level with storage, level_count until anything is loaded
+            sampler_desc sampler;
+        };
+
+    private:
+        // kept after loading so levels can be decoded again on demand
+        struct source_image {
+            std::string path;
+            mip_options options;
+            int width;
+            int height;
+            bool failed;
+            int atlas_x; // placement inside its atlas page, when it has one
+            int atlas_y;
+        };
+
+        std::vector<source_image> images;
+        std::vector<texture_layer> layers;
+        std::vector<array_info> arrays;
+        std::vector<std::vector<unsigned int>> array_images; // texture ids per array, atlas entries last
+        unsigned int atlas = invalid;
+        unsigned int first_page = 0;
+        unsigned int page_count = 0;
+        staging_buffer staging;
+
+        // one array at a time is built on the pool while frames keep rendering
+        struct stream_state {
+            unsigned int array = invalid;
+            int first_level = 0;
+            std::atomic<unsigned int> remaining { 0 };
+            std::atomic<size_t> decoded_bytes { 0 };
+            std::atomic<size_t> copied_bytes { 0 };
+        };
+        stream_state stream;
+        staging_buffer stream_staging;
+        const asset_vfs* files = nullptr;
+
+        asset_view open_source(const source_image& image) const {
+            if (files) return files->open(image.path.c_str());
+            static const asset_vfs loose;
+            return loose.open(image.path.c_str());
+        }
+
+        static bool power_of_two(int x) {
+            return x > 0 && (x & (x - 1)) == 0;
+        }
+
+        unsigned int find_or_add_array(std::map<std::pair<int, int>, unsigned int>& by_size, int width, int height) {
+            auto key = std::make_pair(width, height);
+            auto found = by_size.find(key);
+            if (found != by_size.end()) return found->second;
+            auto level_count = mip_level_count(width, height);
+            arrays.push_back(array_info { 0, width, height, 0, level_count, level_count, default_sampler() });
+            array_images.emplace_back();
+            by_size[key] = arrays.size() - 1;
+            return arrays.size() - 1;
+        }
+
+        static void copy_rect(unsigned char* page, int page_width, int x, int y, const unsigned char* image,
+                int width, int height) {
+            for (int row = 0; row < height; row++) {
+                memcpy(&page[((size_t)(y + row) * page_width + x) * 4], &image[(size_t)row * width * 4], (size_t)width * 4);
+            }
+        }
+
+        // decodes straight from the archive or a mapping of the file; stb_image's
+        // own buffer is the only intermediate. Falls back to a magenta image of the planned size.
+        const unsigned char* decode(const source_image& image, unsigned char*& owned) {
+            owned = nullptr;
+            if (!image.failed) {
+                auto file = open_source(image);
+                int width, height, number_of_color_channels;
+                if (file.data()) {
+                    owned = stbi_load_from_memory(file.data(), (int)file.size(), &width, &height,
+                            &number_of_color_channels, 4);
+                }
+                assrt(owned, "Failed to decode texture {%s}", image.path.c_str());
+                if (owned) return owned;
+            }
+            static const unsigned char magenta[4] = { 255, 0, 255, 255 };
+            thread_local std::vector<unsigned char> fallback;
+            fallback.resize((size_t)image.width * image.height * 4);
+            for (size_t i = 0; i < fallback.size(); i += 4) memcpy(&fallback[i], magenta, 4);
+            return fallback.data();
+        }
+
+        static void run(thread_pool* pool, unsigned int count, const std::function<void(unsigned int, unsigned int)>& fn) {
+            if (pool) pool->parallel_for(count, 1, fn);
+            else fn(0, count);
+        }
+
+        // reads headers only and decides every texture's array, layer and rect
+        void plan() {
+            std::map<std::pair<int, int>, unsigned int> by_size;
+            std::vector<unsigned int> odd;
+            for (unsigned int i = 0; i < images.size(); i++) {
+                auto& image = images[i];
+                auto file = open_source(image);
+                int number_of_color_channels;
+                image.failed = !file.data()
+                    || !stbi_info_from_memory(file.data(), (int)file.size(), &image.width, &image.height,
+                            &number_of_color_channels);
+                assrt(!image.failed, "Failed to load texture {%s}", image.path.c_str());
+                if (image.failed) image.width = image.height = 1;
+                stats.file_bytes += file.size();
+
+                auto fits_atlas = image.width + atlas_padding * 2 <= atlas_page_size
+                    && image.height + atlas_padding * 2 <= atlas_page_size;
+                if (!(power_of_two(image.width) && power_of_two(image.height)) && fits_atlas) {
+                    odd.push_back(i);
+                    continue;
+                }
+                auto a = find_or_add_array(by_size, image.width, image.height);
+                layers[i] = texture_layer { a, arrays[a].layer_count++, glm::vec4(0.f, 0.f, 1.f, 1.f) };
+                array_images[a].push_back(i);
+            }
+
+            // shelf packing, tallest first so rows waste little height
+            std::sort(odd.begin(), odd.end(), [this](unsigned int a, unsigned int b) {
+                return images[a].height > images[b].height;
+            });
+            int x = 0, y = 0, shelf_height = 0;
+            for (auto i : odd) {
+                auto& image = images[i];
+                auto w = image.width + atlas_padding * 2, h = image.height + atlas_padding * 2;
+                if (x + w > atlas_page_size) {
+                    x = 0;
+                    y += shelf_height;
+                    shelf_height = 0;
+                }
+                if (page_count == 0 || y + h > atlas_page_size) {
+                    if (page_count == 0) {
+                        atlas = find_or_add_array(by_size, atlas_page_size, atlas_page_size);
+                        first_page = arrays[atlas].layer_count;
+                    }
+                    page_count++;
+                    arrays[atlas].layer_count++;
+                    x = y = shelf_height = 0;
+                }
+                image.atlas_x = x + atlas_padding;
+                image.atlas_y = y + atlas_padding;
+                auto scale = 1.f / atlas_page_size;
+                layers[i] = texture_layer { atlas, first_page + page_count - 1,
+                    glm::vec4(image.atlas_x * scale, image.atlas_y * scale, image.width * scale, image.height * scale) };
+                array_images[atlas].push_back(i);
+                x += w;
+                shelf_height = std::max(shelf_height, h);
+            }
+        }
+
+        size_t chain_bytes(unsigned int a, int first_level) const {
+            const auto& info = arrays[a];
+            return mip_chain_size(info.width, info.height) - mip_level_offset(info.width, info.height, first_level);
+        }
+
+        // Decodes what goes into one layer and writes its levels first_level
+        // and up to out. Safe to run on any thread, one call per layer.
+        void build_layer(unsigned int a, unsigned int layer, int first_level, unsigned char* out,
+                std::atomic<size_t>& decoded_bytes, std::atomic<size_t>& copied_bytes) {
+            if (a != atlas || layer < first_page) {
+                for (auto i : array_images[a]) {
+                    if (layers[i].layer != layer) continue;
+                    const auto& image = images[i];
+                    unsigned char* owned;
+                    auto pixels = decode(image, owned);
+                    build_mip_chain(pixels, image.width, image.height, image.options, out, first_level);
+                    if (owned) decoded_bytes += (size_t)image.width * image.height * 4;
+                    if (first_level == 0) copied_bytes += (size_t)image.width * image.height * 4;
+                    stbi_image_free(owned);
+                    return;
+                }
+                return;
+            }
+
+            // pages are composed in client memory; mapped memory is too slow to read back from
+            thread_local std::vector<unsigned char> page;
+            page.assign((size_t)atlas_page_size * atlas_page_size * 4, 0);
+            for (auto i : array_images[a]) {
+                if (layers[i].layer != layer) continue;
+                const auto& image = images[i];
+                unsigned char* owned;
+                auto pixels = decode(image, owned);
+                copy_rect(page.data(), atlas_page_size, image.atlas_x, image.atlas_y, pixels, image.width, image.height);
+                if (owned) decoded_bytes += (size_t)image.width * image.height * 4;
+                copied_bytes += (size_t)image.width * image.height * 4;
+                stbi_image_free(owned);
+            }
+            // pages hold unrelated images, so they get the default filtering without coverage fixes
+            build_mip_chain(page.data(), atlas_page_size, atlas_page_size, mip_options(), out, first_level);
+            if (first_level == 0) copied_bytes += page.size();
+        }
+
+        // Uploads the levels built from first_level, as laid out by
+        // build_layer(), that aren't resident yet and makes first_level the
+        // new base level. GL thread only.
+        void commit(unsigned int a, int first_level, staging_buffer& buffer) {
+            auto& info = arrays[a];
+            auto skipped = mip_level_offset(info.width, info.height, first_level);
+            auto chain_size = chain_bytes(a, first_level);
+
+            glBindTexture(GL_TEXTURE_2D_ARRAY, info.texture);
+            // storage first: a null pointer would be an offset once the staging buffer is bound
+            for (int level = first_level; level < info.base_level; level++) {
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, std::max(info.width >> level, 1),
+                        std::max(info.height >> level, 1), info.layer_count, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            }
+            buffer.bind();
+            for (unsigned int layer = 0; layer < info.layer_count; layer++) {
+                for (int level = first_level; level < info.base_level; level++) {
+                    auto offset = chain_size * layer + mip_level_offset(info.width, info.height, level) - skipped;
+                    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, std::max(info.width >> level, 1),
+                            std::max(info.height >> level, 1), 1, GL_RGBA, GL_UNSIGNED_BYTE, (void*)offset);
+                }
+            }
+            buffer.unbind();
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, first_level);
+            info.base_level = first_level;
+        }
+
+        // Builds levels first_level and up of every layer on the pool straight
+        // into the staging buffer and uploads the missing ones before returning.
+        void fill(unsigned int a, int first_level, thread_pool* pool) {
+            auto& info = arrays[a];
+            auto chain_size = chain_bytes(a, first_level);
+            std::atomic<size_t> decoded_bytes(0), copied_bytes(0);
+            auto out = staging.map(chain_size * info.layer_count);
+            run(pool, info.layer_count, [&](unsigned int begin, unsigned int end) {
+                for (auto layer = begin; layer < end; layer++) {
+                    build_layer(a, layer, first_level, out + chain_size * layer, decoded_bytes, copied_bytes);
+                }
+            });
+            commit(a, first_level, staging);
+
+            stats.decoded_bytes += decoded_bytes;
+            stats.copied_bytes += copied_bytes;
+            stats.staged_bytes += chain_size * info.layer_count;
+        }
+
+    public:
+        texture_load_stats stats = {};
+
+        // loading happens in upload(); returns the id passed to get()
+        unsigned int add(const char* path, const mip_options& options = mip_options()) {
+            images.push_back(source_image { path, options, 0, 0, false, 0, 0 });
+            layers.push_back(texture_layer { 0, 0, glm::vec4(0.f, 0.f, 1.f, 1.f) });
+            return layers.size() - 1;
+        }
+
+        const texture_layer& get(unsigned int id) const { return layers[id]; }
+        unsigned int size() const { return layers.size(); }
+        const std::vector<array_info>& get_arrays() const { return arrays; }
+
+        // where images are read from; null maps loose files directly
+        void set_files(const asset_vfs* vfs) { files = vfs; }
+
+        // size of the image itself in texels, not of the array or atlas page holding it
+        glm::vec2 texel_size(unsigned int id) const {
+            return glm::vec2((float)images[id].width, (float)images[id].height);
+        }
+
+        // first level that is small enough to always stay resident
+        int tail_level(unsigned int a) const {
+            const auto& info = arrays[a];
+            auto level = 0;
+            while (level < info.level_count - 1 && std::max(info.width >> level, info.height >> level) > tail_size) level++;
+            return level;
+        }
+
+        // Decodes and mipmaps on the pool straight into mapped pixel unpack
+        // memory, one array at a time so only one array's worth is staged.
+        // With tail_only just the levels from tail_level() down are uploaded
+        // and the rest is left to stream_levels(); images are still decoded
+        // and filtered in full to get there.
+        void upload(thread_pool* pool = nullptr, bool tail_only = false) {
+            auto start = std::chrono::steady_clock::now();
+            stats = texture_load_stats {};
+            // the flip flag is global in stb_image, so set it before any worker decodes
+            stbi_set_flip_vertically_on_load(true);
+            plan();
+
+            for (unsigned int a = 0; a < arrays.size(); a++) {
+                auto& info = arrays[a];
+                glGenTextures(1, &info.texture);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, info.texture);
+                // filtering and wrapping come from sampler objects, see bind()
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, info.level_count - 1);
+                fill(a, tail_only ? tail_level(a) : 0, pool);
+            }
+
+            stats.peak_rss = peak_rss_bytes();
+            stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        // estimated video memory of one level of an array, all layers
+        size_t level_bytes(unsigned int a, int level) const {
+            const auto& info = arrays[a];
+            return (size_t)std::max(info.width >> level, 1) * std::max(info.height >> level, 1) * info.layer_count * 4;
+        }
+
+        size_t resident_bytes(unsigned int a) const {
+            size_t bytes = 0;
+            for (int level = arrays[a].base_level; level < arrays[a].level_count; level++) bytes += level_bytes(a, level);
+            return bytes;
+        }
+
+        // frees every level finer than base_level; sampling clamps to what is left
+        void drop_levels(unsigned int a, int base_level) {
+            auto& info = arrays[a];
+            base_level = std::min(base_level, info.level_count - 1);
+            if (base_level <= info.base_level) return;
+            glBindTexture(GL_TEXTURE_2D_ARRAY, info.texture);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, base_level);
+            // mutable storage: respecifying a level as empty releases it
+            for (int level = info.base_level; level < base_level; level++) {
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, 0, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            }
+            info.base_level = base_level;
+        }
+
+        // decodes the sources again to bring levels back down to base_level
+        void restore_levels(unsigned int a, int base_level, thread_pool* pool = nullptr) {
+            if (base_level >= arrays[a].base_level) return;
+            fill(a, std::max(base_level, 0), pool);
+        }
+
+        // Like restore_levels(), but the decoding runs on the pool in the
+        // background and finish_stream() uploads the result on a later frame.
+        // False while another array is still streaming.
+        bool stream_levels(unsigned int a, int base_level, thread_pool* pool) {
+            base_level = std::max(base_level, 0);
+            if (stream.array != invalid || base_level >= arrays[a].base_level) return false;
+            // without workers the jobs would run inline anyway, so skip the staging round trip
+            if (!pool || pool->size() <= 1) {
+                fill(a, base_level, pool);
+                return true;
+            }
+
+            auto chain_size = chain_bytes(a, base_level);
+            auto layer_count = arrays[a].layer_count;
+            auto out = stream_staging.map(chain_size * layer_count);
+            stream.array = a;
+            stream.first_level = base_level;
+            stream.decoded_bytes = 0;
+            stream.copied_bytes = 0;
+            stream.remaining.store(layer_count, std::memory_order_relaxed);
+            for (unsigned int layer = 0; layer < layer_count; layer++) {
+                pool->submit([this, a, layer, base_level, out, chain_size] {
+                    build_layer(a, layer, base_level, out + chain_size * layer, stream.decoded_bytes, stream.copied_bytes);
+                    stream.remaining.fetch_sub(1, std::memory_order_release);
+                });
+            }
+            return true;
+        }
+
+        bool streaming(unsigned int a) const { return stream.array == a; }
+        bool stream_pending() const { return stream.array != invalid; }
+
+        // Uploads a finished stream; call once per frame on the GL thread.
+        // Returns the array whose levels arrived, or invalid.
+        unsigned int finish_stream() {
+            if (stream.array == invalid || stream.remaining.load(std::memory_order_acquire) > 0) return invalid;
+            auto a = stream.array;
+            commit(a, stream.first_level, stream_staging);
+            stats.decoded_bytes += stream.decoded_bytes;
+            stats.copied_bytes += stream.copied_bytes;
+            stats.staged_bytes += chain_bytes(a, stream.first_level) * arrays[a].layer_count;
+            stream.array = invalid;
+            return a;
+        }
+
+        // call while the context is still current
+        void release() {
+            // jobs still write into the stream's staging memory
+            while (stream.array != invalid && stream.remaining.load(std::memory_order_acquire) > 0) {
+                std::this_thread::yield();
+            }
+            stream.array = invalid;
+            stream_staging.release();
+            for (auto& info : arrays) {
+                if (info.texture) glDeleteTextures(1, &info.texture);
+                info.texture = 0;
+                info.base_level = info.level_count;
+            }
+            staging.release();
+        }
+
+        static sampler_desc default_sampler() {
+            sampler_desc desc;
+            desc.wrap_s = desc.wrap_t = desc.wrap_r = GL_MIRROR_CLAMP_TO_EDGE;
+            return desc;
+        }
+
+        // changes how an array is sampled without touching the texture
+        void set_sampler(unsigned int a, const sampler_desc& desc) { arrays[a].sampler = desc; }
+
+        // every array on its own unit with its sampler, once; materials then
+        // only pick a unit and layer
+        void bind(GLuint first_unit, sampler_cache& samplers) const {
+            for (unsigned int a = 0; a < arrays.size(); a++) {
+                glActiveTexture(GL_TEXTURE0 + first_unit + a);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[a].texture);
+                samplers.bind(first_unit + a, arrays[a].sampler);
+            }
+        }
+};
+
+#endif
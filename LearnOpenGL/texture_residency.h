@@ -0,0 +1,150 @@
+#ifndef TEXTURE_RESIDENCY_H
+#define TEXTURE_RESIDENCY_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "texture_array.h"
+#include "thread_pool.h"
+
+// Keeps the texture arrays inside a video memory budget.
+//
+// Memory is estimated per array and mip level from texture_arrays. Arrays
+// used in a frame are touched with the base level they want, usually from
+// texture_mip_level(); update() then drops the finest level of the least
+// recently used arrays until the total fits, and streams missing levels in
+// the background for arrays that are wanted finer than what is resident.
+// Arrays in use only give up levels finer than they asked for, and every
+// array keeps its small tail levels, so anything loaded can be sampled.
+// The unit is a whole array: every layer of it shares the same levels.
+
+// Finest level worth having for a texture whose image spans texels_per_unit
+// texels per world unit, seen at pixels_per_unit screen pixels per world unit.
+inline int texture_mip_level(float texels_per_unit, float pixels_per_unit) {
+    if (pixels_per_unit <= 0.f) return 1000;
+    return (int)std::floor(std::log2(std::max(texels_per_unit / pixels_per_unit, 1.f)));
+}
+
+struct texture_residency_stats {
+    size_t budget;
+    size_t resident;      // estimated bytes after the last update()
+    unsigned int evicted;  // levels dropped, since start
+    unsigned int restored; // levels requested again
+    unsigned int streamed; // background loads that have arrived
+};
+
+class texture_residency {
+    private:
+        struct array_state {
+            uint64_t last_used = 0;
+            int wanted_level = 0;
+        };
+
+        size_t budget;
+        uint64_t frame = 1;
+        std::vector<array_state> states;
+
+        // finest level an array can be evicted down to right now
+        int keep_level(const texture_arrays& textures, unsigned int a) const {
+            auto tail = textures.tail_level(a);
+            return states[a].last_used == frame ? std::min(states[a].wanted_level, tail) : tail;
+        }
+
+        size_t total(const texture_arrays& textures) const {
+            size_t bytes = 0;
+            for (unsigned int a = 0; a < textures.get_arrays().size(); a++) bytes += textures.resident_bytes(a);
+            return bytes;
+        }
+
+        // drops one level from the least recently used array that still has
+        // something to give, so arrays in use this frame come last; false
+        // when there is none
+        bool evict_one(texture_arrays& textures) {
+            const auto& arrays = textures.get_arrays();
+            auto victim = texture_arrays::invalid;
+            for (unsigned int a = 0; a < arrays.size(); a++) {
+                if (textures.streaming(a) || arrays[a].base_level >= keep_level(textures, a)) continue;
+                if (victim == texture_arrays::invalid || states[a].last_used < states[victim].last_used) victim = a;
+            }
+            if (victim == texture_arrays::invalid) return false;
+            textures.drop_levels(victim, arrays[victim].base_level + 1);
+            stats.evicted++;
+            return true;
+        }
+
+        // bytes evict_one() could still free this frame
+        size_t evictable(const texture_arrays& textures) const {
+            const auto& arrays = textures.get_arrays();
+            size_t bytes = 0;
+            for (unsigned int a = 0; a < arrays.size(); a++) {
+                if (textures.streaming(a)) continue;
+                for (auto level = arrays[a].base_level; level < keep_level(textures, a); level++) {
+                    bytes += textures.level_bytes(a, level);
+                }
+            }
+            return bytes;
+        }
+
+    public:
+        texture_residency_stats stats = {};
+
+        explicit texture_residency(size_t budget_bytes) : budget(budget_bytes) {
+            stats.budget = budget;
+        }
+
+        void set_budget(size_t budget_bytes) {
+            budget = budget_bytes;
+            stats.budget = budget;
+        }
+
+        // marks an array as used this frame, wanting levels from base_level up
+        void touch(unsigned int array, int base_level = 0) {
+            if (array >= states.size()) states.resize(array + 1);
+            auto& s = states[array];
+            // several materials can share an array; the finest request wins
+            s.wanted_level = s.last_used == frame ? std::min(s.wanted_level, base_level) : base_level;
+            s.last_used = frame;
+        }
+
+        // Call once per frame after the touches, on the GL thread. One array
+        // streams at a time, so a burst of requests can't flood the pool or
+        // the staging memory.
+        void update(texture_arrays& textures, thread_pool* pool = nullptr) {
+            const auto& arrays = textures.get_arrays();
+            states.resize(arrays.size());
+            if (textures.finish_stream() != texture_arrays::invalid) stats.streamed++;
+
+            auto resident = total(textures);
+            while (resident > budget && evict_one(textures)) resident = total(textures);
+
+            for (unsigned int a = 0; a < arrays.size() && !textures.stream_pending(); a++) {
+                const auto& info = arrays[a];
+                if (states[a].last_used != frame || info.base_level <= states[a].wanted_level) continue;
+
+                // the finest level that fits once other arrays give up what they can
+                auto room = budget + evictable(textures);
+                auto target = info.base_level;
+                size_t extra = 0;
+                for (auto level = info.base_level - 1; level >= states[a].wanted_level; level--) {
+                    if (resident + extra + textures.level_bytes(a, level) > room) break;
+                    extra += textures.level_bytes(a, level);
+                    target = level;
+                }
+                if (target < info.base_level) {
+                    while (resident + extra > budget && evict_one(textures)) resident = total(textures);
+                    stats.restored += info.base_level - target;
+                    textures.stream_levels(a, target, pool);
+                    resident = total(textures);
+                    break;
+                }
+            }
+
+            stats.resident = resident;
+            frame++;
+        }
+};
+
+#endif
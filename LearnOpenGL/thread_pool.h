@@ -0,0 +1,171 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running two kinds of work: parallel_for loops,
+// which workers join as soon as they are free, and fire-and-forget jobs from
+// submit(), which they run when no loop needs help. The thread calling
+// parallel_for claims chunks of its own loop alongside the workers and never
+// runs anything else, so a long background job can't land on a frame's
+// critical path; a pool with zero workers still makes progress (everything
+// just runs inline). Loops hand out chunk indices from an atomic counter and
+// submitted jobs sit in a ring that only grows, so steady-state frames don't
+// allocate.
+class thread_pool {
+    private:
+        struct chunked_job {
+            const std::function<void(unsigned int, unsigned int)>* fn;
+            unsigned int chunk_size;
+            unsigned int count;
+            unsigned int chunks;
+            std::atomic<unsigned int> next { 0 }; // next chunk index to claim
+            unsigned int helpers = 0; // workers inside run_chunks, under the mutex
+        };
+
+        std::vector<std::thread> workers;
+        std::vector<chunked_job*> loops; // parallel_for calls with chunks left to claim
+        std::vector<std::function<void()>> jobs; // ring of job_count entries from job_head
+        size_t job_head = 0;
+        size_t job_count = 0;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable helpers_done;
+        bool stopping = false;
+
+        // callers hold the mutex
+        void push_job(std::function<void()>&& job) {
+            if (job_count == jobs.size()) {
+                std::vector<std::function<void()>> grown(std::max<size_t>(jobs.size() * 2, 64));
+                for (size_t i = 0; i < job_count; i++) grown[i] = std::move(jobs[(job_head + i) % jobs.size()]);
+                jobs.swap(grown);
+                job_head = 0;
+            }
+            jobs[(job_head + job_count) % jobs.size()] = std::move(job);
+            job_count++;
+        }
+
+        std::function<void()> pop_job() {
+            auto job = std::move(jobs[job_head]);
+            job_head = (job_head + 1) % jobs.size();
+            job_count--;
+            return job;
+        }
+
+        // callers hold the mutex; no worker joins the loop afterwards
+        void retire(chunked_job* loop) {
+            auto found = std::find(loops.begin(), loops.end(), loop);
+            if (found != loops.end()) loops.erase(found);
+        }
+
+        static void run_chunks(chunked_job& loop) {
+            for (auto chunk = loop.next.fetch_add(1); chunk < loop.chunks; chunk = loop.next.fetch_add(1)) {
+                auto begin = chunk * loop.chunk_size;
+                (*loop.fn)(begin, std::min(begin + loop.chunk_size, loop.count));
+            }
+        }
+
+        void worker_loop() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                wake.wait(lock, [this] { return stopping || !loops.empty() || job_count; });
+                if (!loops.empty()) {
+                    auto loop = loops.back();
+                    loop->helpers++;
+                    lock.unlock();
+                    run_chunks(*loop);
+                    lock.lock();
+                    // every chunk is claimed now
+                    retire(loop);
+                    if (--loop->helpers == 0) helpers_done.notify_all();
+                    continue;
+                }
+                if (stopping && !job_count) return;
+                auto job = pop_job();
+                lock.unlock();
+                job();
+                lock.lock();
+            }
+        }
+
+    public:
+        // thread_count of 0 uses one worker per hardware thread, minus the caller
+        explicit thread_pool(unsigned int thread_count = 0) {
+            if (thread_count == 0) {
+                auto hardware = std::thread::hardware_concurrency();
+                thread_count = hardware > 1 ? hardware - 1 : 0;
+            }
+            for (unsigned int i = 0; i < thread_count; i++) {
+                workers.emplace_back([this] { worker_loop(); });
+            }
+        }
+
+        ~thread_pool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (auto& worker : workers) worker.join();
+        }
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        unsigned int size() const {
+            return workers.size() + 1;
+        }
+
+        // fire and forget; completion has to be signalled by the job itself.
+        // Without workers the job runs before this returns.
+        void submit(std::function<void()> job) {
+            if (workers.empty()) {
+                job();
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                push_job(std::move(job));
+            }
+            wake.notify_one();
+        }
+
+        // Calls fn(begin, end) over [0, count) split into at most size() * 4
+        // chunks of at least min_chunk items, and returns once all have run.
+        void parallel_for(unsigned int count, unsigned int min_chunk,
+                const std::function<void(unsigned int, unsigned int)>& fn) {
+            if (count == 0) return;
+            min_chunk = std::max(min_chunk, 1u);
+            auto chunks = std::min(size() * 4, (count + min_chunk - 1) / min_chunk);
+            if (chunks <= 1 || workers.empty()) {
+                fn(0, count);
+                return;
+            }
+
+            chunked_job loop;
+            loop.fn = &fn;
+            loop.chunk_size = (count + chunks - 1) / chunks;
+            loop.count = count;
+            // rounding can leave fewer chunks than planned
+            loop.chunks = (count + loop.chunk_size - 1) / loop.chunk_size;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                loops.push_back(&loop);
+            }
+            wake.notify_all();
+
+            run_chunks(loop);
+            // the chunks still running belong to workers that joined; wait for them
+            std::unique_lock<std::mutex> lock(mutex);
+            retire(&loop);
+            helpers_done.wait(lock, [&loop] { return loop.helpers == 0; });
+        }
+};
+
+#endif